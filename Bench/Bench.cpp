@@ -0,0 +1,298 @@
+// Microbenchmarks for the reader, the writer and every filter on synthetic images.
+//
+//   image_processor_bench [--json] [--filter name] [--sizes 1mp,12mp,50mp,odd] [--min-time seconds] [-j threads]
+//
+// Every case runs once to warm up and then repeatedly for at least --min-time seconds. The
+// median time of a run is reported as ns per pixel and MB/s of 24-bit pixel data, along
+// with the number and total size of heap allocations a run makes. Build with
+// optimizations (-DCMAKE_BUILD_TYPE=Release) for meaningful numbers.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../Filters/Filters.h"
+#include "../Image/Image.h"
+#include "../Parser/Parser.h"
+#include "../Reading_and_writing/Reader.h"
+#include "../Reading_and_writing/Writer.h"
+#include "../Server/Json.h"
+#include "../Threads/Scheduler.h"
+
+namespace {
+std::atomic<size_t> allocation_count = 0;
+std::atomic<size_t> allocated_bytes = 0;
+
+void* Allocate(size_t size, size_t alignment) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    size = std::max<size_t>(size, 1);
+    void* memory = alignment <= alignof(std::max_align_t)
+                       ? std::malloc(size)
+                       : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+}  // namespace
+
+void* operator new(size_t size) {
+    return Allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return Allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+const double DEFAULT_MIN_TIME = 0.5;
+
+struct ImageSize {
+    std::string name;
+    size_t width;
+    size_t height;
+};
+
+// Odd widths leave 1 and 3 bytes of padding at the end of every BMP row.
+const std::vector<ImageSize> IMAGE_SIZES = {
+    {"1mp", 1000, 1000}, {"12mp", 4000, 3000}, {"50mp", 8192, 6144}, {"odd", 999, 1001}, {"odd", 4001, 2999}};
+
+// Filters with the command line arguments they are benchmarked with.
+const std::vector<std::vector<std::string>> FILTER_CASES = {
+    {"-crop", "500", "500"}, {"-neg"}, {"-gs"}, {"-sharp"}, {"-edge", "0.1"}, {"-blur", "0.5"}, {"-blur", "3"},
+    {"-blur", "20"},         {"-pix", "2"}, {"-pix", "16"}, {"-pix", "16", "avg"}, {"-boxblur", "2"},
+    {"-boxblur", "50"},      {"-conv", "1,4,6,4,1;4,16,24,16,4;6,24,36,24,6;4,16,24,16,4;1,4,6,4,1", "256"},
+    {"-conv", "1,1,1;1,-8,1;1,1,1"}, {"-resize", "640", "480"}, {"-resize", "640", "480", "lanczos3"}};
+
+struct Options {
+    bool json = false;
+    std::string filter;
+    std::vector<std::string> sizes;
+    double min_time = DEFAULT_MIN_TIME;
+    size_t thread_count = 0;
+};
+
+struct Result {
+    std::string name;
+    std::string params;
+    size_t width = 0;
+    size_t height = 0;
+    size_t iterations = 0;
+    double seconds = 0;
+    double allocations = 0;
+    double allocated_bytes = 0;
+};
+
+// Smooth gradients with noise on top, so that no filter sees a trivial image.
+Image MakeImage(size_t width, size_t height) {
+    Image image(width, height);
+    uint32_t state = 2463534242u;
+    for (size_t i = 0; i < height; ++i) {
+        Color* row = image.GetRow(i);
+        for (size_t j = 0; j < width; ++j) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            const size_t noise = state & 31;
+            row[j] = Color(static_cast<uint8_t>((j * 255 / width + noise) & 255),
+                           static_cast<uint8_t>((i * 255 / height + noise) & 255),
+                           static_cast<uint8_t>(((i + j) * 127 / (width + height) + (state >> 8 & 127)) & 255));
+        }
+    }
+    return image;
+}
+
+Result Measure(const std::string& name, const std::string& params, const ImageSize& size, double min_time,
+               const std::function<void()>& run) {
+    using Clock = std::chrono::steady_clock;
+    run();
+    std::vector<double> times;
+    const size_t count_before = allocation_count.load();
+    const size_t bytes_before = allocated_bytes.load();
+    const Clock::time_point start = Clock::now();
+    do {
+        const Clock::time_point begin = Clock::now();
+        run();
+        times.push_back(std::chrono::duration<double>(Clock::now() - begin).count());
+    } while (std::chrono::duration<double>(Clock::now() - start).count() < min_time);
+
+    Result result{name, params, size.width, size.height, times.size()};
+    std::nth_element(times.begin(), times.begin() + static_cast<std::ptrdiff_t>(times.size() / 2), times.end());
+    result.seconds = times[times.size() / 2];
+    result.allocations = static_cast<double>(allocation_count.load() - count_before) / static_cast<double>(times.size());
+    result.allocated_bytes = static_cast<double>(allocated_bytes.load() - bytes_before) / static_cast<double>(times.size());
+    return result;
+}
+
+double GetNanosecondsPerPixel(const Result& result) {
+    return result.seconds * 1e9 / static_cast<double>(result.width * result.height);
+}
+
+double GetMegabytesPerSecond(const Result& result) {
+    return static_cast<double>(result.width * result.height * sizeof(Color)) / result.seconds / 1e6;
+}
+
+std::string Join(const std::vector<std::string>& words, size_t begin) {
+    std::string result;
+    for (size_t i = begin; i < words.size(); ++i) {
+        result += (i == begin ? "" : " ") + words[i];
+    }
+    return result;
+}
+
+bool IsSelected(const Options& options, const ImageSize& size) {
+    return options.sizes.empty() || std::find(options.sizes.begin(), options.sizes.end(), size.name) != options.sizes.end();
+}
+
+bool IsSelected(const Options& options, const std::string& name) {
+    return name.find(options.filter) != std::string::npos;
+}
+
+std::vector<Result> RunBenchmarks(const Options& options) {
+    std::vector<Result> results;
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / ("image_processor_bench_" + std::to_string(getpid()) + ".bmp");
+    for (const ImageSize& size : IMAGE_SIZES) {
+        if (!IsSelected(options, size)) {
+            continue;
+        }
+        const Image image = MakeImage(size.width, size.height);
+        if (IsSelected(options, "write")) {
+            results.push_back(Measure("write", "", size, options.min_time,
+                                      [&] { reading_and_writing::Writer(path.string()).Write(image); }));
+        }
+        if (IsSelected(options, "read")) {
+            reading_and_writing::Writer(path.string()).Write(image);
+            results.push_back(Measure("read", "", size, options.min_time,
+                                      [&] { reading_and_writing::Reader(path.string()).Read(); }));
+        }
+        for (const std::vector<std::string>& arguments : FILTER_CASES) {
+            const std::string name = arguments[0].substr(1);
+            if (!IsSelected(options, name)) {
+                continue;
+            }
+            parser::Token token;
+            token.name = arguments[0];
+            token.args.assign(arguments.begin() + 1, arguments.end());
+            const std::unique_ptr<filters::Filter> filter = filters::GetFilter(token);
+            results.push_back(Measure(name, Join(arguments, 1), size, options.min_time, [&] { filter->Apply(image); }));
+        }
+        if (!options.json) {
+            std::cerr << "done " << size.width << "x" << size.height << std::endl;
+        }
+    }
+    std::filesystem::remove(path);
+    return results;
+}
+
+void PrintTable(const std::vector<Result>& results) {
+    std::cout << std::left << std::setw(8) << "case" << std::setw(10) << "params" << std::setw(12) << "size"
+              << std::right << std::setw(8) << "runs" << std::setw(12) << "ns/pixel" << std::setw(12) << "MB/s"
+              << std::setw(10) << "allocs" << std::setw(14) << "alloc bytes" << "\n";
+    std::cout << std::fixed;
+    for (const Result& result : results) {
+        std::cout << std::left << std::setw(8) << result.name << std::setw(10) << result.params << std::setw(12)
+                  << (std::to_string(result.width) + "x" + std::to_string(result.height)) << std::right
+                  << std::setw(8) << result.iterations << std::setw(12) << std::setprecision(3)
+                  << GetNanosecondsPerPixel(result) << std::setw(12) << std::setprecision(1)
+                  << GetMegabytesPerSecond(result) << std::setw(10) << std::setprecision(1) << result.allocations
+                  << std::setw(14) << std::setprecision(0) << result.allocated_bytes << "\n";
+    }
+}
+
+void PrintJson(const std::vector<Result>& results) {
+    std::cout << "{\n  \"threads\": " << threads::GetThreadCount() << ",\n  \"instruction_set\": "
+              << server::QuoteJson(filters::kernels::GetInstructionSet()) << ",\n  \"results\": [";
+    std::cout << std::setprecision(6);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        std::cout << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << server::QuoteJson(result.name)
+                  << ", \"params\": " << server::QuoteJson(result.params) << ", \"width\": " << result.width
+                  << ", \"height\": " << result.height << ", \"iterations\": " << result.iterations
+                  << ", \"seconds\": " << result.seconds << ", \"ns_per_pixel\": " << GetNanosecondsPerPixel(result)
+                  << ", \"mb_per_s\": " << GetMegabytesPerSecond(result) << ", \"allocations\": " << result.allocations
+                  << ", \"allocated_bytes\": " << result.allocated_bytes << "}";
+    }
+    std::cout << "\n  ]\n}\n";
+}
+
+Options ParseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Option " + argument + " requires an argument");
+            }
+            return argv[++i];
+        };
+        if (argument == "--json") {
+            options.json = true;
+        } else if (argument == "--filter") {
+            options.filter = value();
+        } else if (argument == "--sizes") {
+            std::istringstream sizes(value());
+            std::string size;
+            while (std::getline(sizes, size, ',')) {
+                options.sizes.push_back(size);
+            }
+        } else if (argument == "--min-time") {
+            options.min_time = std::stod(value());
+        } else if (argument == "-j") {
+            options.thread_count = std::stoul(value());
+        } else {
+            throw std::invalid_argument("Unknown option " + argument);
+        }
+    }
+    return options;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const Options options = ParseOptions(argc, argv);
+        if (options.thread_count != 0) {
+            threads::SetThreadCount(options.thread_count);
+        }
+        const std::vector<Result> results = RunBenchmarks(options);
+        if (options.json) {
+            PrintJson(results);
+        } else {
+            PrintTable(results);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
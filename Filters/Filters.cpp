@@ -1,115 +1,575 @@
 #include "Filters.h"
 
-template <typename T>
-std::vector<T> filters::Filter::ApplyFilterToPixel(const std::vector<std::vector<T>>& matrix, const Image& image,
-                                                   size_t x, size_t y) const {
-    T blue = 0;
-    T green = 0;
-    T red = 0;
-
-    for (size_t i = 0; i < matrix.size(); ++i) {
-        for (size_t j = 0; j < matrix.front().size(); ++j) {
-            size_t row_index = std::min((x + i >= 1) ? x - 1 + i : 0, image.GetHeight() - 1);
-            size_t column_index = std::min((y + j >= 1) ? y - 1 + j : 0, image.GetWidth() - 1);
-            Color color = image.GetColor(row_index, column_index);
-            blue += color.blue * matrix[i][j];
-            green += color.green * matrix[i][j];
-            red += color.red * matrix[i][j];
-        }
-    }
-    blue =
-        std::clamp(blue, static_cast<T>(image::utils::MIN_COLOR_VALUE), static_cast<T>(image::utils::MAX_COLOR_VALUE));
-    green =
-        std::clamp(green, static_cast<T>(image::utils::MIN_COLOR_VALUE), static_cast<T>(image::utils::MAX_COLOR_VALUE));
-    red = std::clamp(red, static_cast<T>(image::utils::MIN_COLOR_VALUE), static_cast<T>(image::utils::MAX_COLOR_VALUE));
-    return {blue, green, red};
-}
-
-Image filters::Crop::Apply(const Image& image) const {
-    size_t new_width = std::min(image.GetWidth(), width_);
-    size_t new_height = std::min(image.GetHeight(), height_);
-    std::vector<std::vector<Color>> new_image_data(new_height, std::vector<Color>(new_width));
-    for (size_t i = 0; i < new_height; ++i) {
-        std::vector<Color> row(new_width);
-        for (size_t j = 0; j < new_width; ++j) {
-            row[j] = image.GetColor(i, j);
+#include <cctype>
+#include <complex>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <sstream>
+
+namespace {
+constexpr filters::stencil::Matrix3x3 SHARPENING_MATRIX = {{{0, -1, 0}, {-1, 5, -1}, {0, -1, 0}}};
+constexpr filters::stencil::Matrix3x3 EDGE_MATRIX = {{{0, -1, 0}, {-1, 4, -1}, {0, -1, 0}}};
+
+uint8_t ClampColor(int value) {
+    return static_cast<uint8_t>(std::clamp(value, image::utils::MIN_COLOR_VALUE, image::utils::MAX_COLOR_VALUE));
+}
+
+uint8_t ClampColor(float value) {
+    return static_cast<uint8_t>(std::clamp(value, static_cast<float>(image::utils::MIN_COLOR_VALUE),
+                                           static_cast<float>(image::utils::MAX_COLOR_VALUE)));
+}
+
+// Luma with the floating-point grayscale formula, which Edge keeps: a single level of gray
+// can move a pixel across the threshold, so the fixed-point formula of Grayscale would give
+// different edges. The products come from per-channel tables and are added in the same
+// order as in the formula, so the result is exactly the same.
+struct LumaTables {
+    std::array<double, image::utils::MAX_COLOR_VALUE + 1> red;
+    std::array<double, image::utils::MAX_COLOR_VALUE + 1> green;
+    std::array<double, image::utils::MAX_COLOR_VALUE + 1> blue;
+
+    LumaTables() {
+        for (size_t i = 0; i < red.size(); ++i) {
+            red[i] = image::utils::RED_FACTOR * static_cast<double>(i);
+            green[i] = image::utils::GREEN_FACTOR * static_cast<double>(i);
+            blue[i] = image::utils::BLUE_FACTOR * static_cast<double>(i);
+        }
+    }
+};
+
+void LumaRow(const Color* row, uint8_t* luma, size_t width) {
+    static const LumaTables TABLES;
+    for (size_t j = 0; j < width; ++j) {
+        luma[j] = static_cast<uint8_t>(TABLES.red[row[j].red] + TABLES.green[row[j].green] + TABLES.blue[row[j].blue]);
+    }
+}
+
+// Applies EDGE_MATRIX to a row of lumas and stores white where the result is above limit,
+// black elsewhere. Edge columns repeat their own luma outside of the row.
+void EdgeRow(const uint8_t* above, const uint8_t* row, const uint8_t* below, size_t width, int limit,
+             Color* new_row) {
+    const int center = EDGE_MATRIX[1][1];
+    const int side = EDGE_MATRIX[0][1];
+    static_assert(EDGE_MATRIX[0][1] == EDGE_MATRIX[1][0] && EDGE_MATRIX[1][0] == EDGE_MATRIX[1][2] &&
+                      EDGE_MATRIX[1][2] == EDGE_MATRIX[2][1] && EDGE_MATRIX[0][0] == 0 && EDGE_MATRIX[0][2] == 0 &&
+                      EDGE_MATRIX[2][0] == 0 && EDGE_MATRIX[2][2] == 0,
+                  "EdgeRow only adds the centre and its four direct neighbours");
+    auto store = [&](size_t j, size_t left, size_t right) {
+        const int sum = center * row[j] + side * (row[left] + row[right] + above[j] + below[j]);
+        const uint8_t value = std::min(sum, image::utils::MAX_COLOR_VALUE) > limit ? image::utils::MAX_COLOR_VALUE
+                                                                                   : image::utils::MIN_COLOR_VALUE;
+        new_row[j].blue = value;
+        new_row[j].green = value;
+        new_row[j].red = value;
+    };
+    if (width == 0) {
+        return;
+    }
+    const size_t last = width - 1;
+    store(0, 0, last == 0 ? 0 : 1);
+    for (size_t j = 1; j < last; ++j) {
+        store(j, j - 1, j + 1);
+    }
+    if (last > 0) {
+        store(last, last - 1, last);
+    }
+}
+
+// Rounded mean of area pixels with the given channel sums.
+Color GetMean(const filters::SummedAreaTable::Sums& sums, uint64_t area) {
+    Color mean;
+    mean.blue = static_cast<uint8_t>((sums.blue + area / 2) / area);
+    mean.green = static_cast<uint8_t>((sums.green + area / 2) / area);
+    mean.red = static_cast<uint8_t>((sums.red + area / 2) / area);
+    return mean;
+}
+
+// Rows a box blur computes from one summed-area table, at least.
+const size_t BOX_BLUR_CHUNK_ROWS = 32;
+// Keeps the halo, and the rows streaming keeps around it, within reason.
+const size_t MAX_BOX_BLUR_RADIUS = 65535;
+
+// Largest number of rows or columns of a convolution kernel.
+const size_t MAX_CONVOLUTION_SIZE = 255;
+// Largest width or height -resize takes.
+const size_t MAX_RESIZE_DIMENSION = 1 << 20;
+// A kernel is run as two 1-D passes when every weight is this close to the product of its
+// factors, relative to the largest weight. Float weights parsed from decimals are off by
+// about 1e-7 relative, so kernels written as rank-1 are still recognised as such.
+const double SEPARABLE_TOLERANCE = 1e-5;
+// Number of float values per row a convolution accumulates at once.
+const size_t CONVOLUTION_STRIP_SIZE = 1024;
+
+// Converts a row to floats, with margin copies of its first and last pixels on either side.
+void PadRow(const Color* row, size_t width, size_t margin, float* padded) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row);
+    const size_t row_size = width * image::utils::BYTES_PER_PIXEL;
+    const size_t margin_size = margin * image::utils::BYTES_PER_PIXEL;
+    const uint8_t* last = bytes + row_size - image::utils::BYTES_PER_PIXEL;
+    for (size_t b = 0; b < margin_size; ++b) {
+        padded[b] = bytes[b % image::utils::BYTES_PER_PIXEL];
+        padded[margin_size + row_size + b] = last[b % image::utils::BYTES_PER_PIXEL];
+    }
+    std::copy(bytes, bytes + row_size, padded + margin_size);
+}
+
+void StoreRow(const std::vector<float>& sums, Color* row) {
+    std::transform(sums.begin(), sums.end(), reinterpret_cast<uint8_t*>(row),
+                   [](float sum) { return ClampColor(sum + 0.5f); });
+}
+
+// Larger blurs would need kernels far wider than any image.
+const float MAX_BLUR_SIGMA = 10000;
+// Widest kernel the fixed-point blur takes. Rounding every weight to 1 / 2^14 moves the sum
+// of a kernel by up to taps / 2^15, which at this size is about 0.6% of it and grows with
+// the width, so wider kernels run in floating point.
+const size_t MAX_FIXED_POINT_BLUR_TAPS = 6 * 32 + 1;
+// Number of byte columns the vertical recursive pass filters at once.
+const size_t RECURSIVE_BLUR_STRIP_SIZE = 256;
+// Samples of state the third-order recursion keeps on either side of a line.
+const size_t RECURSIVE_BLUR_ORDER = 3;
+// The recursive blur depends on whole columns. Bands filtered separately, as streaming
+// does, see this many sigmas of rows past their edges: past that the impulse response is
+// negligible, and results differ from whole columns by float rounding, at most a level.
+const float RECURSIVE_BLUR_HALO_SIGMAS = 4.0f;
+
+// Recursive Gaussian of Young, van Vliet and Verbeek in the normalized form
+// w[n] = b * x[n] + a1 * w[n - 1] + a2 * w[n - 2] + a3 * w[n - 3], run forwards and then
+// backwards. The filter poles are those fitted for sigma = 2, raised to the power 1 / q
+// with q chosen so that the impulse response has exactly the requested variance. The
+// Triggs - Sdika matrix starts the backward pass as if the line continued with its last
+// value forever.
+struct RecursiveGaussian {
+    float b = 0;
+    float a1 = 0;
+    float a2 = 0;
+    float a3 = 0;
+    std::array<double, 9> border = {};
+
+    explicit RecursiveGaussian(double sigma) {
+        const std::array<std::complex<double>, 3> base_poles = {
+            std::complex<double>(1.41650, 1.00829), std::complex<double>(1.41650, -1.00829),
+            std::complex<double>(1.86543, 0)};
+        auto get_poles = [&base_poles](double q) {
+            std::array<std::complex<double>, 3> poles;
+            for (size_t i = 0; i < poles.size(); ++i) {
+                poles[i] = std::polar(std::pow(std::abs(base_poles[i]), 1 / q), std::arg(base_poles[i]) / q);
+            }
+            return poles;
+        };
+        // The variance of the forward and backward passes together, 2 * sum d / (d - 1)^2,
+        // grows with q, so q is found by bisection.
+        auto get_variance = [](const std::array<std::complex<double>, 3>& poles) {
+            std::complex<double> variance = 0;
+            for (const std::complex<double>& pole : poles) {
+                variance += 2.0 * pole / ((pole - 1.0) * (pole - 1.0));
+            }
+            return variance.real();
+        };
+        double low = 1e-2;
+        double high = 1e4;
+        for (int i = 0; i < 100; ++i) {
+            double middle = std::sqrt(low * high);
+            (get_variance(get_poles(middle)) < sigma * sigma ? low : high) = middle;
+        }
+        std::array<std::complex<double>, 3> poles = get_poles(low);
+        for (std::complex<double>& pole : poles) {
+            pole = 1.0 / pole;
+        }
+        double c1 = (poles[0] + poles[1] + poles[2]).real();
+        double c2 = -(poles[0] * poles[1] + poles[0] * poles[2] + poles[1] * poles[2]).real();
+        double c3 = (poles[0] * poles[1] * poles[2]).real();
+
+        double scale = (1 - c1 - c2 - c3) / ((1 + c1 - c2 + c3) * (1 - c1 - c2 - c3) * (1 + c2 + (c1 - c3) * c3));
+        border = {scale * (-c3 * c1 + 1 - c3 * c3 - c2),
+                  scale * (c3 + c1) * (c2 + c3 * c1),
+                  scale * c3 * (c1 + c3 * c2),
+                  scale * (c1 + c3 * c2),
+                  -scale * (c2 - 1) * (c2 + c3 * c1),
+                  -scale * c3 * (c3 * c1 + c3 * c3 + c2 - 1),
+                  scale * (c3 * c1 + c2 + c1 * c1 - c2 * c2),
+                  scale * (c1 * c2 + c3 * c2 * c2 - c1 * c3 * c3 - c3 * c3 * c3 - c3 * c2 + c3),
+                  scale * c3 * (c1 + c3 * c2)};
+        b = static_cast<float>(1 - c1 - c2 - c3);
+        a1 = static_cast<float>(c1);
+        a2 = static_cast<float>(c2);
+        a3 = static_cast<float>(c3);
+    }
+
+    // Filters length samples of channels interleaved values each. The line starts
+    // RECURSIVE_BLUR_ORDER samples into values, which has room for RECURSIVE_BLUR_ORDER
+    // more samples after its end as well.
+    void Apply(float* values, size_t length, size_t channels) const {
+        const size_t first = RECURSIVE_BLUR_ORDER * channels;
+        const size_t last = first + (length - 1) * channels;
+        // Before the line starts it continues with its first value, for which the forward
+        // pass is already steady. The last value is kept for the backward pass.
+        for (size_t c = 0; c < first; ++c) {
+            values[c] = values[first + c % channels];
+        }
+        for (size_t c = 0; c < channels; ++c) {
+            values[last + channels + c] = values[last + c];
+        }
+
+        for (size_t n = first; n <= last; n += channels) {
+            for (size_t c = n; c < n + channels; ++c) {
+                values[c] = b * values[c] + a1 * values[c - channels] + a2 * values[c - 2 * channels] +
+                            a3 * values[c - 3 * channels];
+            }
+        }
+
+        for (size_t c = last; c < last + channels; ++c) {
+            const double last_value = values[c + channels];
+            const double u0 = values[c] - last_value;
+            const double u1 = values[c - channels] - last_value;
+            const double u2 = values[c - 2 * channels] - last_value;
+            values[c] = static_cast<float>(border[0] * u0 + border[1] * u1 + border[2] * u2 + last_value);
+            values[c + channels] = static_cast<float>(border[3] * u0 + border[4] * u1 + border[5] * u2 + last_value);
+            values[c + 2 * channels] =
+                static_cast<float>(border[6] * u0 + border[7] * u1 + border[8] * u2 + last_value);
+        }
+        for (size_t n = last; n > first;) {
+            n -= channels;
+            for (size_t c = n; c < n + channels; ++c) {
+                values[c] = b * values[c] + a1 * values[c + channels] + a2 * values[c + 2 * channels] +
+                            a3 * values[c + 3 * channels];
+            }
         }
-        new_image_data[i] = row;
     }
-    return Image(new_image_data);
+};
+}  // namespace
+
+Image filters::Filter::Apply(const Image& image) const {
+    Image new_image;
+    ApplyTo(image, new_image);
+    return new_image;
+}
+
+void filters::Filter::ApplyTo(const Image& image, Image& result) const {
+    result = image;
+    ApplyInPlace(result);
+}
+
+void filters::Filter::ApplyInPlace(Image& image) const {
+    Image new_image;
+    ApplyTo(image, new_image);
+    image = std::move(new_image);
+}
+
+bool filters::Filter::IsInPlace() const {
+    return false;
+}
+
+size_t filters::Filter::GetHalo() const {
+    return 0;
+}
+
+size_t filters::Filter::GetRowAlignment() const {
+    return 1;
+}
+
+const std::string& filters::Filter::GetName() const {
+    return name_;
+}
+
+void filters::Filter::SetName(std::string name) {
+    name_ = std::move(name);
+}
+
+size_t filters::Filter::GetResultWidth(size_t width) const {
+    return width;
+}
+
+size_t filters::Filter::GetResultHeight(size_t height) const {
+    return height;
+}
+
+bool filters::Filter::MakesGray() const {
+    return false;
+}
+
+bool filters::Filter::KeepsGray() const {
+    return false;
+}
+
+std::vector<threads::RowBand> filters::Filter::SplitRows(size_t rows) const {
+    return threads::SplitRows(rows, GetRowAlignment(), GetHalo());
+}
+
+void filters::Crop::ApplyTo(const Image& image, Image& result) const {
+    size_t new_width = GetResultWidth(image.GetWidth());
+    size_t new_height = GetResultHeight(image.GetHeight());
+    result.Reshape(new_width, new_height);
+    for (size_t i = 0; i < new_height; ++i) {
+        const Color* row = image.GetRow(i);
+        std::copy(row, row + new_width, result.GetRow(i));
+    }
+}
+
+void filters::Crop::ApplyInPlace(Image& image) const {
+    image.Truncate(GetResultWidth(image.GetWidth()), GetResultHeight(image.GetHeight()));
+}
+
+bool filters::Crop::IsInPlace() const {
+    return true;
 }
 
-Image filters::Negative::Apply(const Image& image) const {
-    std::vector<std::vector<Color>> new_image_data(image.GetHeight(), std::vector<Color>(image.GetWidth()));
-    for (size_t i = 0; i < image.GetHeight(); ++i) {
-        std::vector<Color> row(image.GetWidth());
-        for (size_t j = 0; j < image.GetWidth(); ++j) {
-            Color color = image.GetColor(i, j);
-            row[j].SetVals(static_cast<uint8_t>(image::utils::MAX_COLOR_VALUE - color.blue),
-                           static_cast<uint8_t>(image::utils::MAX_COLOR_VALUE - color.green),
-                           static_cast<uint8_t>(image::utils::MAX_COLOR_VALUE - color.red));
+size_t filters::Crop::GetResultWidth(size_t width) const {
+    return std::min(width, width_);
+}
+
+size_t filters::Crop::GetResultHeight(size_t height) const {
+    return std::min(height, height_);
+}
+
+bool filters::Crop::KeepsGray() const {
+    return true;
+}
+
+filters::ColorTransform::ColorTransform() {
+    for (ChannelTable& table : before_mix_) {
+        for (size_t value = 0; value < table.size(); ++value) {
+            table[value] = static_cast<uint8_t>(value);
         }
-        new_image_data[i] = row;
     }
-    return Image(new_image_data);
+    after_mix_ = before_mix_;
 }
 
-Image filters::Grayscale::Apply(const Image& image) const {
-    std::vector<std::vector<Color>> new_image_data(image.GetHeight(), std::vector<Color>(image.GetWidth()));
-    for (size_t i = 0; i < image.GetHeight(); ++i) {
-        std::vector<Color> row(image.GetWidth());
-        for (size_t j = 0; j < image.GetWidth(); ++j) {
-            Color color = image.GetColor(i, j);
-            uint8_t gray =
-                static_cast<uint8_t>(image::utils::RED_FACTOR * color.red + image::utils::GREEN_FACTOR * color.green +
-                                     image::utils::BLUE_FACTOR * color.blue);
-            row[j].SetVals(gray, gray, gray);
+void filters::ColorTransform::AppendChannelMap(const ChannelTable& blue, const ChannelTable& green,
+                                               const ChannelTable& red) {
+    const std::array<const ChannelTable*, 3> maps = {&blue, &green, &red};
+    std::array<ChannelTable, 3>& tables = mixes_channels_ ? after_mix_ : before_mix_;
+    for (size_t channel = 0; channel < tables.size(); ++channel) {
+        for (uint8_t& value : tables[channel]) {
+            value = (*maps[channel])[value];
         }
-        new_image_data[i] = row;
     }
-    return Image(new_image_data);
+    Classify();
 }
 
-Image filters::Sharpening::Apply(const Image& image) const {
-    std::vector<std::vector<Color>> new_image_data(image.GetHeight(), std::vector<Color>(image.GetWidth()));
-    const std::vector<std::vector<int>> matrix = {{0, -1, 0}, {-1, 5, -1}, {0, -1, 0}};
-    for (size_t i = 0; i < image.GetHeight(); ++i) {
-        std::vector<Color> row(image.GetWidth());
-        for (size_t j = 0; j < image.GetWidth(); ++j) {
-            std::vector<int> pixel_colors = ApplyFilterToPixel<int>(matrix, image, i, j);
-            row[j].SetVals(pixel_colors[0], pixel_colors[1], pixel_colors[2]);
+void filters::ColorTransform::AppendGrayscale() {
+    if (mixes_channels_) {
+        // After the first mix all channels are functions of one gray value, so a further
+        // grayscale conversion folds into the output tables.
+        ChannelTable gray;
+        for (size_t value = 0; value < gray.size(); ++value) {
+            gray[value] = kernels::Gray(after_mix_[0][value], after_mix_[1][value], after_mix_[2][value]);
         }
-        new_image_data[i] = row;
+        after_mix_.fill(gray);
     }
-    return Image(new_image_data);
+    mixes_channels_ = true;
+    Classify();
 }
 
-Image filters::Edge::Apply(const Image& image) const {
-    std::vector<std::vector<Color>> new_image_data(image.GetHeight(), std::vector<Color>(image.GetWidth()));
-    const std::vector<std::vector<int>> matrix = {{0, -1, 0}, {-1, 4, -1}, {0, -1, 0}};
-    Image grayscale_image = filters::Grayscale().Apply(image);
-    for (size_t i = 0; i < grayscale_image.GetHeight(); ++i) {
-        std::vector<Color> row(grayscale_image.GetWidth());
-        for (size_t j = 0; j < grayscale_image.GetWidth(); ++j) {
-            std::vector<int> pixel_colors = ApplyFilterToPixel<int>(matrix, grayscale_image, i, j);
-            double pixel_color_value = pixel_colors[0];
-            if (static_cast<double>(pixel_color_value) > image::utils::MAX_COLOR_VALUE * threshold_) {
-                row[j].SetVals(image::utils::MAX_COLOR_VALUE, image::utils::MAX_COLOR_VALUE,
-                               image::utils::MAX_COLOR_VALUE);
-            } else {
-                row[j].SetVals(image::utils::MIN_COLOR_VALUE, image::utils::MIN_COLOR_VALUE,
-                               image::utils::MIN_COLOR_VALUE);
+bool filters::ColorTransform::IsIdentity() const {
+    return kind_ == Kind::IDENTITY;
+}
+
+bool filters::ColorTransform::IsTable(const std::array<ChannelTable, 3>& tables, const ChannelTable& table) {
+    return std::all_of(tables.begin(), tables.end(), [&table](const ChannelTable& other) { return other == table; });
+}
+
+void filters::ColorTransform::Classify() {
+    ChannelTable identity;
+    ChannelTable negative;
+    for (size_t value = 0; value < identity.size(); ++value) {
+        identity[value] = static_cast<uint8_t>(value);
+        negative[value] = static_cast<uint8_t>(image::utils::MAX_COLOR_VALUE - value);
+    }
+    if (mixes_channels_) {
+        kind_ = IsTable(before_mix_, identity) && IsTable(after_mix_, identity) ? Kind::GRAYSCALE : Kind::LOOKUP;
+    } else if (IsTable(before_mix_, identity)) {
+        kind_ = Kind::IDENTITY;
+    } else if (IsTable(before_mix_, negative)) {
+        kind_ = Kind::NEGATIVE;
+    } else {
+        kind_ = Kind::LOOKUP;
+    }
+}
+
+Color filters::ColorTransform::Apply(const Color& color) const {
+    uint8_t blue = before_mix_[0][color.blue];
+    uint8_t green = before_mix_[1][color.green];
+    uint8_t red = before_mix_[2][color.red];
+    if (!mixes_channels_) {
+        return Color(blue, green, red);
+    }
+    uint8_t gray = kernels::Gray(blue, green, red);
+    return Color(after_mix_[0][gray], after_mix_[1][gray], after_mix_[2][gray]);
+}
+
+void filters::ColorTransform::ApplyToRow(const Color* row, Color* new_row, size_t width) const {
+    switch (kind_) {
+        case Kind::IDENTITY:
+            if (row != new_row) {
+                std::copy(row, row + width, new_row);
             }
+            break;
+        case Kind::NEGATIVE:
+            kernels::NegativeRow(row, new_row, width);
+            break;
+        case Kind::GRAYSCALE:
+            kernels::GrayscaleRow(row, new_row, width);
+            break;
+        case Kind::LOOKUP:
+            for (size_t j = 0; j < width; ++j) {
+                new_row[j] = Apply(row[j]);
+            }
+            break;
+    }
+}
+
+void filters::PointFilter::ApplyTo(const Image& image, Image& result) const {
+    ColorTransform transform;
+    AppendTo(transform);
+    if (transform.IsIdentity()) {
+        result = image;
+        return;
+    }
+    result.Reshape(image.GetWidth(), image.GetHeight());
+    threads::ForEachBand(SplitRows(image.GetHeight()), [&](const threads::RowBand& band) {
+        for (size_t i = band.begin; i < band.end; ++i) {
+            transform.ApplyToRow(image.GetRow(i), result.GetRow(i), image.GetWidth());
+        }
+    });
+}
+
+void filters::PointFilter::ApplyInPlace(Image& image) const {
+    ColorTransform transform;
+    AppendTo(transform);
+    if (transform.IsIdentity()) {
+        return;
+    }
+    threads::ForEachBand(SplitRows(image.GetHeight()), [&](const threads::RowBand& band) {
+        for (size_t i = band.begin; i < band.end; ++i) {
+            transform.ApplyToRow(image.GetRow(i), image.GetRow(i), image.GetWidth());
+        }
+    });
+}
+
+bool filters::PointFilter::IsInPlace() const {
+    return true;
+}
+
+void filters::Negative::AppendTo(ColorTransform& transform) const {
+    ColorTransform::ChannelTable negative;
+    for (size_t value = 0; value < negative.size(); ++value) {
+        negative[value] = static_cast<uint8_t>(image::utils::MAX_COLOR_VALUE - value);
+    }
+    transform.AppendChannelMap(negative, negative, negative);
+}
+
+bool filters::Negative::KeepsGray() const {
+    return true;
+}
+
+void filters::Grayscale::AppendTo(ColorTransform& transform) const {
+    transform.AppendGrayscale();
+}
+
+bool filters::Grayscale::MakesGray() const {
+    return true;
+}
+
+bool filters::Grayscale::KeepsGray() const {
+    return true;
+}
+
+void filters::FusedPointFilter::Append(std::unique_ptr<PointFilter> filter) {
+    SetName(GetName().empty() ? filter->GetName() : GetName() + " " + filter->GetName());
+    filters_.push_back(std::move(filter));
+}
+
+void filters::FusedPointFilter::AppendTo(ColorTransform& transform) const {
+    for (const std::unique_ptr<PointFilter>& filter : filters_) {
+        filter->AppendTo(transform);
+    }
+}
+
+size_t filters::FusedPointFilter::GetSize() const {
+    return filters_.size();
+}
+
+bool filters::FusedPointFilter::MakesGray() const {
+    for (auto it = filters_.rbegin(); it != filters_.rend(); ++it) {
+        if ((*it)->MakesGray()) {
+            return true;
+        }
+        if (!(*it)->KeepsGray()) {
+            return false;
         }
-        new_image_data[i] = row;
     }
-    return Image(new_image_data);
+    return false;
+}
+
+bool filters::FusedPointFilter::KeepsGray() const {
+    return std::all_of(filters_.begin(), filters_.end(),
+                       [](const std::unique_ptr<PointFilter>& filter) { return filter->KeepsGray(); });
+}
+
+void filters::Sharpening::ApplyTo(const Image& image, Image& result) const {
+    result.Reshape(image.GetWidth(), image.GetHeight());
+    threads::ForEachBand(SplitRows(image.GetHeight()), [&](const threads::RowBand& band) {
+        for (size_t i = band.begin; i < band.end; ++i) {
+            stencil::ApplyToRow<SHARPENING_MATRIX>(
+                image.GetRow(i == 0 ? 0 : i - 1), image.GetRow(i),
+                image.GetRow(std::min(i + 1, image.GetHeight() - 1)), image.GetWidth(), result.GetRow(i),
+                [](Color& color, const stencil::Sums& sums) {
+                    color.SetVals(ClampColor(sums.blue), ClampColor(sums.green), ClampColor(sums.red));
+                });
+        }
+    });
 }
 
-Image filters::Blur::Apply(const Image& image) const {
-    std::vector<std::vector<Color>> temp_image_data(image.GetHeight(), std::vector<Color>(image.GetWidth()));
-    std::vector<std::vector<Color>> new_image_data(image.GetHeight(), std::vector<Color>(image.GetWidth()));
+size_t filters::Sharpening::GetHalo() const {
+    return 1;
+}
+
+bool filters::Sharpening::KeepsGray() const {
+    return true;
+}
 
+void filters::Edge::ApplyTo(const Image& image, Image& result) const {
+    const size_t width = image.GetWidth();
+    const size_t height = image.GetHeight();
+    // Sums are whole numbers, so comparing them with the integer part of the threshold
+    // gives the same answer as comparing with the threshold.
+    const int limit = static_cast<int>(std::floor(image::utils::MAX_COLOR_VALUE * threshold_));
+
+    // Every band keeps the lumas of the three rows around the current one, computing the
+    // one below as it moves down. The rows just outside of a band are read from the input,
+    // so no band waits for another.
+    result.Reshape(width, height);
+    threads::ForEachBand(SplitRows(height), [&](const threads::RowBand& band) {
+        std::vector<uint8_t> window(3 * width);
+        uint8_t* above = window.data();
+        uint8_t* row = above + width;
+        uint8_t* below = row + width;
+        LumaRow(image.GetRow(band.begin == 0 ? 0 : band.begin - 1), above, width);
+        LumaRow(image.GetRow(band.begin), row, width);
+        for (size_t i = band.begin; i < band.end; ++i) {
+            LumaRow(image.GetRow(std::min(i + 1, height - 1)), below, width);
+            EdgeRow(above, row, below, width, limit, result.GetRow(i));
+            std::swap(above, row);
+            std::swap(row, below);
+        }
+    });
+}
+
+size_t filters::Edge::GetHalo() const {
+    return 1;
+}
+
+bool filters::Edge::MakesGray() const {
+    return true;
+}
+
+bool filters::Edge::KeepsGray() const {
+    return true;
+}
+
+std::vector<float> filters::Blur::GetKernel() const {
     int kernel_size = static_cast<int>(std::ceil(sigma_ * 3)) * 2 + 1;
     std::vector<float> kernel(kernel_size);
 
@@ -124,76 +584,600 @@ Image filters::Blur::Apply(const Image& image) const {
     for (int i = 0; i < kernel_size; ++i) {
         kernel[i] /= sum;
     }
+    return kernel;
+}
+
+void filters::Blur::ApplyTo(const Image& image, Image& result) const {
+    if (IsRecursive()) {
+        ApplyRecursive(image, result);
+    } else if (GetKernel().size() <= MAX_FIXED_POINT_BLUR_TAPS) {
+        ApplyFixedPoint(image, result);
+    } else {
+        ApplyExact(image, result);
+    }
+}
+
+bool filters::Blur::IsRecursive() const {
+    return mode_ == Mode::RECURSIVE || (mode_ == Mode::AUTO && sigma_ >= image::utils::RECURSIVE_BLUR_MIN_SIGMA);
+}
+
+// The weights are rounded to BLUR_WEIGHT_BITS, and the rounding error of their sum goes to
+// the central one so the image keeps its brightness.
+std::vector<int16_t> filters::Blur::GetFixedPointKernel() const {
+    const std::vector<float> kernel = GetKernel();
+    const int32_t one = 1 << kernels::BLUR_WEIGHT_BITS;
+    std::vector<int16_t> weights(kernel.size());
+    int32_t sum = 0;
+    for (size_t k = 0; k < kernel.size(); ++k) {
+        weights[k] = static_cast<int16_t>(std::lround(kernel[k] * static_cast<float>(one)));
+        sum += weights[k];
+    }
+    weights[kernel.size() / 2] = static_cast<int16_t>(weights[kernel.size() / 2] + one - sum);
+    return weights;
+}
 
-    // horizontal blur
-    for (size_t i = 0; i < image.GetHeight(); ++i) {
-        std::vector<Color> row(image.GetWidth());
-        for (size_t j = 0; j < image.GetWidth(); ++j) {
-            float blue = 0;
-            float green = 0;
-            float red = 0;
+// Every output row is blurred on its own: the vertical pass adds up whole input rows around
+// it into a row of 16-bit values, padded with copies of its edge pixels, and the
+// horizontal pass turns that into the output row. Both go along rows, so the input is only
+// ever read row by row.
+void filters::Blur::ApplyFixedPoint(const Image& image, Image& result) const {
+    const size_t width = image.GetWidth();
+    const size_t height = image.GetHeight();
+    result.Reshape(width, height);
+    if (width == 0 || height == 0) {
+        return;
+    }
+    const std::vector<int16_t> weights = GetFixedPointKernel();
+    const size_t taps = weights.size();
+    const size_t half_taps = taps / 2;
+    const size_t row_size = width * image::utils::BYTES_PER_PIXEL;
+    const size_t margin_size = half_taps * image::utils::BYTES_PER_PIXEL;
+    threads::ForEachBand(SplitRows(height), [&](const threads::RowBand& band) {
+        std::vector<const uint8_t*> rows(taps);
+        std::vector<uint16_t> values(row_size + 2 * margin_size);
+        uint16_t* row_values = values.data() + margin_size;
+        for (size_t i = band.begin; i < band.end; ++i) {
+            for (size_t k = 0; k < taps; ++k) {
+                const size_t source_row = std::clamp(i + k, half_taps, height - 1 + half_taps) - half_taps;
+                rows[k] = reinterpret_cast<const uint8_t*>(image.GetRow(source_row));
+            }
+            kernels::BlurColumns(rows.data(), weights.data(), taps, row_values, row_size);
+            const uint16_t* last = row_values + row_size - image::utils::BYTES_PER_PIXEL;
+            for (size_t b = 0; b < margin_size; ++b) {
+                values[b] = row_values[b % image::utils::BYTES_PER_PIXEL];
+                row_values[row_size + b] = last[b % image::utils::BYTES_PER_PIXEL];
+            }
+            kernels::BlurRow(values.data(), weights.data(), taps, reinterpret_cast<uint8_t*>(result.GetRow(i)),
+                             row_size);
+        }
+    });
+}
+
+void filters::Blur::ApplyExact(const Image& image, Image& result) const {
+    const size_t width = image.GetWidth();
+    const size_t height = image.GetHeight();
+    result.Reshape(width, height);
+
+    const std::vector<float> kernel = GetKernel();
+    const int half_kernel_size = static_cast<int>(kernel.size()) / 2;
+    const std::vector<threads::RowBand> bands = SplitRows(height);
+
+    // vertical blur, accumulating whole rows into result so memory is walked row by row;
+    // channels are independent here, so rows are treated as plain byte arrays
+    const size_t row_size = width * image::utils::BYTES_PER_PIXEL;
+    threads::ForEachBand(bands, [&](const threads::RowBand& band) {
+        std::vector<float> sums(row_size);
+        for (size_t i = band.begin; i < band.end; ++i) {
+            std::fill(sums.begin(), sums.end(), 0.0f);
             for (int k = -half_kernel_size; k <= half_kernel_size; ++k) {
-                int column = std::clamp(static_cast<int>(j) + k, 0, static_cast<int>(image.GetWidth()) - 1);
-                Color color = image.GetColor(i, column);
-                blue += static_cast<float>(color.blue) * kernel[k + half_kernel_size];
-                green += static_cast<float>(color.green) * kernel[k + half_kernel_size];
-                red += static_cast<float>(color.red) * kernel[k + half_kernel_size];
+                int row_index = std::clamp(static_cast<int>(i) + k, 0, static_cast<int>(height) - 1);
+                const uint8_t* row = reinterpret_cast<const uint8_t*>(image.GetRow(row_index));
+                const float weight = kernel[k + half_kernel_size];
+                for (size_t b = 0; b < row_size; ++b) {
+                    sums[b] += static_cast<float>(row[b]) * weight;
+                }
+            }
+            uint8_t* new_row = reinterpret_cast<uint8_t*>(result.GetRow(i));
+            for (size_t b = 0; b < row_size; ++b) {
+                new_row[b] = static_cast<uint8_t>(sums[b]);
             }
-            row[j].SetVals(static_cast<uint8_t>(blue), static_cast<uint8_t>(green), static_cast<uint8_t>(red));
         }
-        temp_image_data[i] = row;
+    });
+
+    // horizontal blur, in place one row at a time
+    threads::ForEachBand(bands, [&](const threads::RowBand& band) {
+        std::vector<Color> row(width);
+        for (size_t i = band.begin; i < band.end; ++i) {
+            Color* new_row = result.GetRow(i);
+            std::copy(new_row, new_row + width, row.begin());
+            for (size_t j = 0; j < width; ++j) {
+                float blue = 0;
+                float green = 0;
+                float red = 0;
+                for (int k = -half_kernel_size; k <= half_kernel_size; ++k) {
+                    int column = std::clamp(static_cast<int>(j) + k, 0, static_cast<int>(width) - 1);
+                    const Color& color = row[column];
+                    blue += static_cast<float>(color.blue) * kernel[k + half_kernel_size];
+                    green += static_cast<float>(color.green) * kernel[k + half_kernel_size];
+                    red += static_cast<float>(color.red) * kernel[k + half_kernel_size];
+                }
+                new_row[j].SetVals(static_cast<uint8_t>(blue), static_cast<uint8_t>(green),
+                                   static_cast<uint8_t>(red));
+            }
+        }
+    });
+}
+
+void filters::Blur::ApplyRecursive(const Image& image, Image& result) const {
+    const size_t width = image.GetWidth();
+    const size_t height = image.GetHeight();
+    result.Reshape(width, height);
+    if (width == 0 || height == 0) {
+        return;
     }
+    const RecursiveGaussian gaussian(sigma_);
+    const size_t row_size = width * image::utils::BYTES_PER_PIXEL;
+    const size_t padding = 2 * RECURSIVE_BLUR_ORDER;
 
-    // vertical blur
-    for (size_t i = 0; i < image.GetHeight(); ++i) {
-        std::vector<Color> row(image.GetWidth());
-        for (size_t j = 0; j < image.GetWidth(); ++j) {
-            float blue = 0;
-            float green = 0;
-            float red = 0;
-            for (int k = -half_kernel_size; k <= half_kernel_size; ++k) {
-                int row_index = std::clamp(static_cast<int>(i) + k, 0, static_cast<int>(image.GetHeight()) - 1);
-                Color color = temp_image_data[row_index][j];
-                blue += static_cast<float>(color.blue) * kernel[k + half_kernel_size];
-                green += static_cast<float>(color.green) * kernel[k + half_kernel_size];
-                red += static_cast<float>(color.red) * kernel[k + half_kernel_size];
+    // vertical blur over strips of byte columns, so every row is still read in long runs
+    // and the strip's lines are filtered side by side
+    const size_t strips = (row_size + RECURSIVE_BLUR_STRIP_SIZE - 1) / RECURSIVE_BLUR_STRIP_SIZE;
+    threads::ForEachBand(threads::SplitRows(strips), [&](const threads::RowBand& band) {
+        std::vector<float> values((height + padding) * RECURSIVE_BLUR_STRIP_SIZE);
+        for (size_t strip = band.begin; strip < band.end; ++strip) {
+            const size_t begin = strip * RECURSIVE_BLUR_STRIP_SIZE;
+            const size_t size = std::min(row_size - begin, RECURSIVE_BLUR_STRIP_SIZE);
+            float* line = values.data() + RECURSIVE_BLUR_ORDER * size;
+            for (size_t i = 0; i < height; ++i) {
+                const uint8_t* row = reinterpret_cast<const uint8_t*>(image.GetRow(i)) + begin;
+                std::copy(row, row + size, line + i * size);
+            }
+            gaussian.Apply(values.data(), height, size);
+            for (size_t i = 0; i < height; ++i) {
+                uint8_t* new_row = reinterpret_cast<uint8_t*>(result.GetRow(i)) + begin;
+                std::transform(line + i * size, line + (i + 1) * size, new_row,
+                               [](float value) { return ClampColor(value); });
+            }
+        }
+    });
+
+    // horizontal blur, in place one row at a time
+    threads::ForEachBand(threads::SplitRows(height), [&](const threads::RowBand& band) {
+        std::vector<float> values((width + padding) * image::utils::BYTES_PER_PIXEL);
+        float* line = values.data() + RECURSIVE_BLUR_ORDER * image::utils::BYTES_PER_PIXEL;
+        for (size_t i = band.begin; i < band.end; ++i) {
+            uint8_t* row = reinterpret_cast<uint8_t*>(result.GetRow(i));
+            std::copy(row, row + row_size, line);
+            gaussian.Apply(values.data(), width, image::utils::BYTES_PER_PIXEL);
+            std::transform(line, line + row_size, row, [](float value) { return ClampColor(value); });
+        }
+    });
+}
+
+size_t filters::Blur::GetHalo() const {
+    if (IsRecursive()) {
+        return static_cast<size_t>(std::ceil(RECURSIVE_BLUR_HALO_SIGMAS * sigma_));
+    }
+    return GetKernel().size() / 2;
+}
+
+bool filters::Blur::KeepsGray() const {
+    return true;
+}
+
+void filters::Pixellate::ApplyInPlace(Image& image) const {
+    const size_t width = image.GetWidth();
+    // Bands start at multiples of pixel_size_, so every block lies within one band.
+    threads::ForEachBand(SplitRows(image.GetHeight()), [&](const threads::RowBand& band) {
+        SummedAreaTable table;
+        for (size_t i = band.begin; i < band.end; i += pixel_size_) {
+            const size_t block_end = std::min(i + pixel_size_, band.end);
+            Color* row = image.GetRow(i);
+            if (mode_ == Mode::AVERAGE) {
+                table.Build(image, i, block_end);
+            }
+            for (size_t j = 0; j < width; j += pixel_size_) {
+                const size_t block_right = std::min(j + pixel_size_, width);
+                if (mode_ == Mode::AVERAGE) {
+                    row[j] = GetMean(table.GetSums(i, j, block_end, block_right), (block_end - i) * (block_right - j));
+                }
+                std::fill(row + j + 1, row + block_right, row[j]);
+            }
+            for (size_t k = i + 1; k < block_end; ++k) {
+                std::copy(row, row + width, image.GetRow(k));
+            }
+        }
+    });
+}
+
+bool filters::Pixellate::IsInPlace() const {
+    return true;
+}
+
+size_t filters::Pixellate::GetHalo() const {
+    return pixel_size_ == 0 ? 0 : pixel_size_ - 1;
+}
+
+size_t filters::Pixellate::GetRowAlignment() const {
+    return pixel_size_;
+}
+
+bool filters::Pixellate::KeepsGray() const {
+    return true;
+}
+
+void filters::BoxBlur::ApplyTo(const Image& image, Image& result) const {
+    const size_t width = image.GetWidth();
+    const size_t height = image.GetHeight();
+    // Tables cover a chunk of rows and the radius around it, so they take a bounded amount
+    // of memory. Chunks of at least the radius keep the rows summed twice to at most 3x.
+    const size_t radius = std::min(radius_, std::max(width, height));
+    const size_t chunk_rows = std::max(BOX_BLUR_CHUNK_ROWS, radius);
+    result.Reshape(width, height);
+    threads::ForEachBand(SplitRows(height), [&](const threads::RowBand& band) {
+        SummedAreaTable table;
+        for (size_t chunk = band.begin; chunk < band.end; chunk += chunk_rows) {
+            const size_t chunk_end = std::min(band.end, chunk + chunk_rows);
+            table.Build(image, chunk - std::min(chunk, radius), std::min(height, chunk_end + radius));
+            for (size_t i = chunk; i < chunk_end; ++i) {
+                const size_t top = i - std::min(i, radius);
+                const size_t bottom = std::min(height, i + radius + 1);
+                Color* new_row = result.GetRow(i);
+                for (size_t j = 0; j < width; ++j) {
+                    const size_t left = j - std::min(j, radius);
+                    const size_t right = std::min(width, j + radius + 1);
+                    new_row[j] = GetMean(table.GetSums(top, left, bottom, right), (bottom - top) * (right - left));
+                }
+            }
+        }
+    });
+}
+
+size_t filters::BoxBlur::GetHalo() const {
+    return radius_;
+}
+
+bool filters::BoxBlur::KeepsGray() const {
+    return true;
+}
+
+// The kernel is rank-1 if it is the outer product of its column and row through its largest
+// weight, scaled so that the product gives that weight back.
+filters::Convolution::Convolution(Kernel kernel) : kernel_(std::move(kernel)) {
+    size_t pivot_row = 0;
+    size_t pivot_column = 0;
+    for (size_t i = 0; i < kernel_.size(); ++i) {
+        for (size_t j = 0; j < kernel_[i].size(); ++j) {
+            if (std::abs(kernel_[i][j]) > std::abs(kernel_[pivot_row][pivot_column])) {
+                pivot_row = i;
+                pivot_column = j;
+            }
+        }
+    }
+    const double pivot = kernel_[pivot_row][pivot_column];
+    if (pivot == 0) {
+        column_.assign(GetKernelHeight(), 0);
+        row_.assign(GetKernelWidth(), 0);
+        return;
+    }
+    for (size_t i = 0; i < kernel_.size(); ++i) {
+        for (size_t j = 0; j < kernel_[i].size(); ++j) {
+            const double product = static_cast<double>(kernel_[i][pivot_column]) * kernel_[pivot_row][j] / pivot;
+            if (std::abs(kernel_[i][j] - product) > SEPARABLE_TOLERANCE * std::abs(pivot)) {
+                return;
             }
-            row[j].SetVals(static_cast<uint8_t>(blue), static_cast<uint8_t>(green), static_cast<uint8_t>(red));
         }
-        new_image_data[i] = row;
     }
+    for (size_t i = 0; i < kernel_.size(); ++i) {
+        column_.push_back(kernel_[i][pivot_column]);
+    }
+    for (size_t j = 0; j < kernel_[pivot_row].size(); ++j) {
+        row_.push_back(static_cast<float>(kernel_[pivot_row][j] / pivot));
+    }
+}
 
-    return Image(new_image_data);
+void filters::Convolution::ApplyTo(const Image& image, Image& result) const {
+    result.Reshape(image.GetWidth(), image.GetHeight());
+    if (image.GetWidth() == 0 || image.GetHeight() == 0) {
+        return;
+    }
+    threads::ForEachBand(SplitRows(image.GetHeight()), [&](const threads::RowBand& band) {
+        if (IsSeparable()) {
+            ApplySeparable(image, band, result);
+        } else {
+            ApplyBlocked(image, band, result);
+        }
+    });
 }
 
-Image filters::Pixellate::Apply(const Image& image) const {
-    std::vector<std::vector<Color>> new_image_data(image.GetHeight(), std::vector<Color>(image.GetWidth()));
-    for (size_t i = 0; i < image.GetHeight(); i += pixel_size_) {
-        for (size_t j = 0; j < image.GetWidth(); j += pixel_size_) {
-            Color color = image.GetColor(i, j);
-            for (size_t k = i; k < std::min(i + pixel_size_, image.GetHeight()); ++k) {
-                for (size_t l = j; l < std::min(j + pixel_size_, image.GetWidth()); ++l) {
-                    new_image_data[k][l] = color;
+// Rows filtered horizontally are kept in a ring, row r in slot r % rows, which holds all
+// the rows the vertical pass reads for one output row.
+void filters::Convolution::ApplySeparable(const Image& image, const threads::RowBand& band, Image& result) const {
+    const size_t width = image.GetWidth();
+    const size_t height = image.GetHeight();
+    const size_t rows = column_.size();
+    const size_t row_halo = rows / 2;
+    const size_t column_halo = row_.size() / 2;
+    const size_t row_size = width * image::utils::BYTES_PER_PIXEL;
+    std::vector<float> padded((width + 2 * column_halo) * image::utils::BYTES_PER_PIXEL);
+    std::vector<float> ring(rows * row_size);
+    std::vector<float> sums(row_size);
+    size_t next = band.begin - std::min(band.begin, row_halo);
+    for (size_t i = band.begin; i < band.end; ++i) {
+        for (; next <= std::min(height - 1, i + row_halo); ++next) {
+            PadRow(image.GetRow(next), width, column_halo, padded.data());
+            float* filtered = ring.data() + (next % rows) * row_size;
+            std::fill(filtered, filtered + row_size, 0.0f);
+            for (size_t begin = 0; begin < row_size; begin += CONVOLUTION_STRIP_SIZE) {
+                const size_t end = std::min(row_size, begin + CONVOLUTION_STRIP_SIZE);
+                for (size_t k = 0; k < row_.size(); ++k) {
+                    const float weight = row_[k];
+                    const float* source = padded.data() + k * image::utils::BYTES_PER_PIXEL;
+                    for (size_t b = begin; b < end; ++b) {
+                        filtered[b] += source[b] * weight;
+                    }
                 }
             }
         }
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        for (size_t k = 0; k < rows; ++k) {
+            const float weight = column_[k];
+            if (weight == 0) {
+                continue;
+            }
+            const size_t source_row = std::clamp(i + k, row_halo, height - 1 + row_halo) - row_halo;
+            const float* filtered = ring.data() + (source_row % rows) * row_size;
+            for (size_t b = 0; b < row_size; ++b) {
+                sums[b] += filtered[b] * weight;
+            }
+        }
+        StoreRow(sums, result.GetRow(i));
     }
-    return Image(new_image_data);
 }
 
-std::unique_ptr<filters::Filter> filters::GetFilter(const parser::Token& token) {
+// Input rows are kept padded in a ring as above. Every output row is summed a strip of
+// columns at a time, so the strip of all the rows it reads stays in the cache while it
+// goes through the taps.
+void filters::Convolution::ApplyBlocked(const Image& image, const threads::RowBand& band, Image& result) const {
+    const size_t width = image.GetWidth();
+    const size_t height = image.GetHeight();
+    const size_t rows = GetKernelHeight();
+    const size_t row_halo = rows / 2;
+    const size_t column_halo = GetKernelWidth() / 2;
+    const size_t row_size = width * image::utils::BYTES_PER_PIXEL;
+    const size_t padded_size = (width + 2 * column_halo) * image::utils::BYTES_PER_PIXEL;
+    std::vector<float> ring(rows * padded_size);
+    std::vector<float> sums(row_size);
+    size_t next = band.begin - std::min(band.begin, row_halo);
+    for (size_t i = band.begin; i < band.end; ++i) {
+        for (; next <= std::min(height - 1, i + row_halo); ++next) {
+            PadRow(image.GetRow(next), width, column_halo, ring.data() + (next % rows) * padded_size);
+        }
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        for (size_t begin = 0; begin < row_size; begin += CONVOLUTION_STRIP_SIZE) {
+            const size_t end = std::min(row_size, begin + CONVOLUTION_STRIP_SIZE);
+            for (size_t k = 0; k < rows; ++k) {
+                const size_t source_row = std::clamp(i + k, row_halo, height - 1 + row_halo) - row_halo;
+                const float* padded = ring.data() + (source_row % rows) * padded_size;
+                for (size_t l = 0; l < kernel_[k].size(); ++l) {
+                    const float weight = kernel_[k][l];
+                    if (weight == 0) {
+                        continue;
+                    }
+                    const float* source = padded + l * image::utils::BYTES_PER_PIXEL;
+                    for (size_t b = begin; b < end; ++b) {
+                        sums[b] += source[b] * weight;
+                    }
+                }
+            }
+        }
+        StoreRow(sums, result.GetRow(i));
+    }
+}
+
+size_t filters::Convolution::GetHalo() const {
+    return std::max(GetKernelWidth(), GetKernelHeight()) / 2;
+}
+
+bool filters::Convolution::KeepsGray() const {
+    return true;
+}
+
+bool filters::Convolution::IsSeparable() const {
+    return !row_.empty();
+}
+
+const filters::Convolution::Kernel& filters::Convolution::GetKernel() const {
+    return kernel_;
+}
+
+size_t filters::Convolution::GetKernelWidth() const {
+    return kernel_.front().size();
+}
+
+size_t filters::Convolution::GetKernelHeight() const {
+    return kernel_.size();
+}
+
+void filters::Resize::ApplyTo(const Image& image, Image& result) const {
+    ApplyToRows(image, 0, image.GetHeight(), 0, GetResultHeight(image.GetHeight()), result);
+}
+
+// An empty image stays empty: there is nothing to resample it from.
+size_t filters::Resize::GetResultWidth(size_t width) const {
+    return width == 0 ? 0 : width_;
+}
+
+size_t filters::Resize::GetResultHeight(size_t height) const {
+    return height == 0 ? 0 : height_;
+}
+
+bool filters::Resize::KeepsGray() const {
+    return true;
+}
+
+std::pair<size_t, size_t> filters::Resize::GetSourceRows(size_t height, size_t begin, size_t end) const {
+    if (begin == end) {
+        return {0, 0};
+    }
+    const ResamplingWeights lines(kernel_, height, GetResultHeight(height));
+    return {lines.GetStart(begin), lines.GetStart(end - 1) + lines.GetTaps()};
+}
+
+// Every band keeps the input rows resampled to the new width in a ring, row r in slot
+// r % taps, which holds all the rows one output row is summed from. Windows only move
+// down, so every input row is resampled once per band.
+void filters::Resize::ApplyToRows(const Image& source, size_t source_begin, size_t height, size_t begin, size_t end,
+                                  Image& rows) const {
+    const size_t width = GetResultWidth(source.GetWidth());
+    rows.Reshape(width, end - begin);
+    if (width == 0 || begin == end) {
+        return;
+    }
+    const ResamplingWeights columns(kernel_, source.GetWidth(), width);
+    const ResamplingWeights lines(kernel_, height, GetResultHeight(height));
+    const size_t taps = lines.GetTaps();
+    const size_t row_size = width * image::utils::BYTES_PER_PIXEL;
+    threads::ForEachBand(threads::SplitRows(end - begin), [&](const threads::RowBand& band) {
+        std::vector<float> ring(taps * row_size);
+        std::vector<float> sums(row_size);
+        size_t next = 0;
+        for (size_t i = begin + band.begin; i < begin + band.end; ++i) {
+            const size_t start = lines.GetStart(i);
+            for (size_t r = std::max(next, start); r < start + taps; ++r) {
+                const Color* row = source.GetRow(r - source_begin);
+                float* resampled = ring.data() + (r % taps) * row_size;
+                for (size_t j = 0; j < width; ++j) {
+                    const Color* window = row + columns.GetStart(j);
+                    const float* weights = columns.GetWeights(j);
+                    float blue = 0;
+                    float green = 0;
+                    float red = 0;
+                    for (size_t k = 0; k < columns.GetTaps(); ++k) {
+                        blue += static_cast<float>(window[k].blue) * weights[k];
+                        green += static_cast<float>(window[k].green) * weights[k];
+                        red += static_cast<float>(window[k].red) * weights[k];
+                    }
+                    resampled[j * image::utils::BYTES_PER_PIXEL] = blue;
+                    resampled[j * image::utils::BYTES_PER_PIXEL + 1] = green;
+                    resampled[j * image::utils::BYTES_PER_PIXEL + 2] = red;
+                }
+            }
+            next = std::max(next, start + taps);
+            std::fill(sums.begin(), sums.end(), 0.0f);
+            const float* weights = lines.GetWeights(i);
+            for (size_t k = 0; k < taps; ++k) {
+                if (weights[k] == 0) {
+                    continue;
+                }
+                const float* resampled = ring.data() + ((start + k) % taps) * row_size;
+                for (size_t b = 0; b < row_size; ++b) {
+                    sums[b] += resampled[b] * weights[k];
+                }
+            }
+            StoreRow(sums, rows.GetRow(i - begin));
+        }
+    });
+}
+
+size_t filters::ParseUnsigned(const std::string& arg) {
+    try {
+        return std::stoul(arg);
+    } catch (const std::out_of_range&) {
+        return std::numeric_limits<size_t>::max();
+    }
+}
+
+namespace {
+bool IsUnsigned(const std::string& arg) {
+    return !arg.empty() && std::all_of(arg.begin(), arg.end(), [](unsigned char c) { return std::isdigit(c); });
+}
+
+std::optional<float> ParseFloat(const std::string& arg) {
+    size_t parsed = 0;
+    try {
+        const float value = std::stof(arg, &parsed);
+        if (parsed == arg.size()) {
+            return value;
+        }
+    } catch (const std::logic_error&) {
+    }
+    return std::nullopt;
+}
+
+// Kernels are written row by row, with rows separated by ';' or new lines and weights by ','
+// or spaces. Lines of a file starting with '#' are comments.
+filters::Convolution::Kernel ParseKernel(const std::string& text) {
+    filters::Convolution::Kernel kernel;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first != std::string::npos && line[first] == '#') {
+            continue;
+        }
+        std::replace(line.begin(), line.end(), ';', '\n');
+        std::istringstream rows(line);
+        std::string row_text;
+        while (std::getline(rows, row_text)) {
+            std::replace(row_text.begin(), row_text.end(), ',', ' ');
+            std::istringstream weights(row_text);
+            std::vector<float> row;
+            std::string weight;
+            while (weights >> weight) {
+                const std::optional<float> value = ParseFloat(weight);
+                if (!value || !std::isfinite(*value)) {
+                    throw std::invalid_argument("Convolution kernel weight " + weight + " is not a number");
+                }
+                row.push_back(*value);
+            }
+            if (!row.empty()) {
+                kernel.push_back(std::move(row));
+            }
+        }
+    }
+    if (kernel.empty()) {
+        throw std::invalid_argument("Convolution kernel is empty");
+    }
+    for (const std::vector<float>& row : kernel) {
+        if (row.size() != kernel.front().size()) {
+            throw std::invalid_argument("Convolution kernel rows must all have the same number of weights");
+        }
+    }
+    if (kernel.size() % 2 == 0 || kernel.front().size() % 2 == 0 || kernel.size() > MAX_CONVOLUTION_SIZE ||
+        kernel.front().size() > MAX_CONVOLUTION_SIZE) {
+        throw std::invalid_argument("Convolution kernel must have an odd number of rows and columns, at most " +
+                                    std::to_string(MAX_CONVOLUTION_SIZE));
+    }
+    return kernel;
+}
+
+// A kernel argument is written inline if it has separators or is a single weight, and is
+// the path of a text file otherwise.
+filters::Convolution::Kernel ReadKernel(const std::string& arg) {
+    if (arg.find_first_of(",;") != std::string::npos || ParseFloat(arg)) {
+        return ParseKernel(arg);
+    }
+    std::ifstream file(arg);
+    if (!file) {
+        throw std::invalid_argument("Convolution kernel file " + arg + " can't be opened");
+    }
+    std::ostringstream text;
+    text << file.rdbuf();
+    return ParseKernel(text.str());
+}
+
+std::unique_ptr<filters::Filter> CreateFilter(const parser::Token& token) {
     const std::string& name = token.name;
     if (name == "-crop") {
         if (token.args.size() != 2) {
             throw std::invalid_argument("Crop filter requires exactly two arguments");
         }
-        try {
-            size_t width = std::stoul(token.args[0]);
-            size_t height = std::stoul(token.args[1]);
-            return std::make_unique<filters::Crop>(width, height);
-        } catch (const std::invalid_argument&) {
+        if (!IsUnsigned(token.args[0]) || !IsUnsigned(token.args[1])) {
             throw std::invalid_argument("Crop filter requires non-negative integer arguments");
         }
+        return std::make_unique<filters::Crop>(filters::ParseUnsigned(token.args[0]),
+                                               filters::ParseUnsigned(token.args[1]));
     } else if (name == "-gs") {
         if (!token.args.empty()) {
             throw std::invalid_argument("Grayscale filter doesn't take any arguments");
@@ -213,35 +1197,112 @@ std::unique_ptr<filters::Filter> filters::GetFilter(const parser::Token& token)
         if (token.args.size() != 1) {
             throw std::invalid_argument("Edge filter requires exactly one argument");
         }
-        try {
-            float threshold = std::stof(token.args[0]);
-            if (threshold < 0 || threshold > 1) {
-                throw std::invalid_argument("Edge filter requires a threshold between 0 and 1");
-            }
-            return std::make_unique<filters::Edge>(threshold);
-        } catch (const std::invalid_argument&) {
+        const std::optional<float> threshold = ParseFloat(token.args[0]);
+        if (!threshold) {
             throw std::invalid_argument("Edge filter requires a numeric threshold");
         }
+        if (!(*threshold >= 0 && *threshold <= 1)) {
+            throw std::invalid_argument("Edge filter requires a threshold between 0 and 1");
+        }
+        return std::make_unique<filters::Edge>(*threshold);
     } else if (name == "-blur") {
-        if (token.args.size() != 1) {
-            throw std::invalid_argument("Blur filter requires exactly one argument");
+        if (token.args.empty() || token.args.size() > 2) {
+            throw std::invalid_argument("Blur filter requires a sigma and an optional mode");
+        }
+        filters::Blur::Mode mode = filters::Blur::Mode::AUTO;
+        if (token.args.size() == 2) {
+            if (token.args[1] == "exact") {
+                mode = filters::Blur::Mode::EXACT;
+            } else if (token.args[1] == "iir") {
+                mode = filters::Blur::Mode::RECURSIVE;
+            } else {
+                throw std::invalid_argument("Blur filter mode must be exact or iir");
+            }
         }
-        try {
-            float sigma = std::stof(token.args[0]);
-            return std::make_unique<filters::Blur>(sigma);
-        } catch (const std::invalid_argument&) {
+        const std::optional<float> sigma = ParseFloat(token.args[0]);
+        if (!sigma) {
             throw std::invalid_argument("Blur filter requires a numeric sigma");
         }
+        if (!(*sigma > 0 && *sigma <= MAX_BLUR_SIGMA)) {
+            throw std::invalid_argument("Blur filter requires a sigma greater than 0 and at most " +
+                                        std::to_string(static_cast<int>(MAX_BLUR_SIGMA)));
+        }
+        return std::make_unique<filters::Blur>(*sigma, mode);
     } else if (name == "-pix") {
+        if (token.args.empty() || token.args.size() > 2) {
+            throw std::invalid_argument("Pixellate filter requires a pixel size and an optional mode");
+        }
+        if (!IsUnsigned(token.args[0]) || filters::ParseUnsigned(token.args[0]) == 0) {
+            throw std::invalid_argument("Pixellate filter requires a positive integer pixel size");
+        }
+        filters::Pixellate::Mode mode = filters::Pixellate::Mode::TOP_LEFT;
+        if (token.args.size() == 2) {
+            if (token.args[1] != "avg") {
+                throw std::invalid_argument("Pixellate filter mode must be avg");
+            }
+            mode = filters::Pixellate::Mode::AVERAGE;
+        }
+        return std::make_unique<filters::Pixellate>(filters::ParseUnsigned(token.args[0]), mode);
+    } else if (name == "-boxblur") {
         if (token.args.size() != 1) {
-            throw std::invalid_argument("Pixellate filter requires exactly one argument");
+            throw std::invalid_argument("Box blur filter requires exactly one argument");
         }
-        try {
-            size_t pixel_size = std::stoul(token.args[0]);
-            return std::make_unique<filters::Pixellate>(pixel_size);
-        } catch (const std::invalid_argument&) {
-            throw std::invalid_argument("Pixellate filter requires a non-negative integer pixel size");
+        if (!IsUnsigned(token.args[0]) || filters::ParseUnsigned(token.args[0]) > MAX_BOX_BLUR_RADIUS) {
+            throw std::invalid_argument("Box blur filter requires an integer radius from 0 to " +
+                                        std::to_string(MAX_BOX_BLUR_RADIUS));
+        }
+        return std::make_unique<filters::BoxBlur>(filters::ParseUnsigned(token.args[0]));
+    } else if (name == "-conv") {
+        if (token.args.empty() || token.args.size() > 2) {
+            throw std::invalid_argument("Convolution filter requires a kernel and an optional divisor");
+        }
+        filters::Convolution::Kernel kernel = ReadKernel(token.args[0]);
+        if (token.args.size() == 2) {
+            const std::optional<float> divisor = ParseFloat(token.args[1]);
+            if (!divisor || *divisor == 0 || !std::isfinite(*divisor)) {
+                throw std::invalid_argument("Convolution filter requires a non-zero numeric divisor");
+            }
+            for (std::vector<float>& row : kernel) {
+                for (float& weight : row) {
+                    weight /= *divisor;
+                }
+            }
         }
+        return std::make_unique<filters::Convolution>(std::move(kernel));
+    } else if (name == "-resize") {
+        if (token.args.size() < 2 || token.args.size() > 3) {
+            throw std::invalid_argument("Resize filter requires a width, a height and an optional method");
+        }
+        for (size_t i = 0; i < 2; ++i) {
+            if (!IsUnsigned(token.args[i]) || filters::ParseUnsigned(token.args[i]) == 0 ||
+                filters::ParseUnsigned(token.args[i]) > MAX_RESIZE_DIMENSION) {
+                throw std::invalid_argument("Resize filter requires a width and a height from 1 to " +
+                                            std::to_string(MAX_RESIZE_DIMENSION));
+            }
+        }
+        filters::ResamplingKernel kernel = filters::ResamplingKernel::BICUBIC;
+        if (token.args.size() == 3) {
+            if (token.args[2] == "bilinear") {
+                kernel = filters::ResamplingKernel::BILINEAR;
+            } else if (token.args[2] == "lanczos3") {
+                kernel = filters::ResamplingKernel::LANCZOS3;
+            } else if (token.args[2] != "bicubic") {
+                throw std::invalid_argument("Resize filter method must be bilinear, bicubic or lanczos3");
+            }
+        }
+        return std::make_unique<filters::Resize>(filters::ParseUnsigned(token.args[0]),
+                                                 filters::ParseUnsigned(token.args[1]), kernel);
     }
     throw std::runtime_error("Invalid token");
 }
+}  // namespace
+
+std::unique_ptr<filters::Filter> filters::GetFilter(const parser::Token& token) {
+    std::unique_ptr<Filter> filter = CreateFilter(token);
+    std::string name = token.name;
+    for (const std::string& arg : token.args) {
+        name += " " + arg;
+    }
+    filter->SetName(std::move(name));
+    return filter;
+}
@@ -0,0 +1,439 @@
+#include "Kernels.h"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGE_PROCESSOR_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace filters::kernels {
+namespace {
+using RowKernel = void (*)(const Color*, Color*, size_t);
+using BlurColumnsKernel = void (*)(const uint8_t* const*, const int16_t*, size_t, uint16_t*, size_t);
+using BlurRowKernel = void (*)(const uint16_t*, const int16_t*, size_t, uint8_t*, size_t);
+
+struct KernelTable {
+    const char* instruction_set;
+    RowKernel grayscale;
+    RowKernel negative;
+    BlurColumnsKernel blur_columns;
+    BlurRowKernel blur_row;
+};
+
+const int BLUR_COLUMNS_SHIFT = BLUR_WEIGHT_BITS - BLUR_FRACTION_BITS;
+const int BLUR_ROW_SHIFT = BLUR_WEIGHT_BITS + BLUR_FRACTION_BITS;
+
+#ifdef IMAGE_PROCESSOR_X86_KERNELS
+// Masks of every element, for the zero-masking forms of AVX-512 intrinsics. GCC implements
+// the unmasked forms of some as merges into an undefined vector, which -Wuninitialized
+// reports.
+const __mmask8 ALL_LANES = 0xF;
+const __mmask16 ALL_DWORDS = 0xFFFF;
+const __mmask32 ALL_WORDS = 0xFFFFFFFF;
+#endif
+
+void GrayscaleRowScalar(const Color* row, Color* new_row, size_t width) {
+    for (size_t j = 0; j < width; ++j) {
+        uint8_t gray = Gray(row[j].blue, row[j].green, row[j].red);
+        new_row[j].SetVals(gray, gray, gray);
+    }
+}
+
+void NegativeBytesScalar(const uint8_t* bytes, uint8_t* new_bytes, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        new_bytes[i] = static_cast<uint8_t>(~bytes[i]);
+    }
+}
+
+void NegativeRowScalar(const Color* row, Color* new_row, size_t width) {
+    NegativeBytesScalar(reinterpret_cast<const uint8_t*>(row), reinterpret_cast<uint8_t*>(new_row),
+                        width * sizeof(Color));
+}
+
+// The scalar blur passes take the byte to start at, so the vector ones can finish a row
+// with them. The vertical pass rounds; the horizontal one truncates, as the floating-point
+// blurs do.
+void BlurColumnsScalar(const uint8_t* const* rows, const int16_t* weights, size_t taps, uint16_t* values,
+                       size_t begin, size_t size) {
+    for (size_t b = begin; b < size; ++b) {
+        int32_t sum = 1 << (BLUR_COLUMNS_SHIFT - 1);
+        for (size_t k = 0; k < taps; ++k) {
+            sum += weights[k] * rows[k][b];
+        }
+        values[b] = static_cast<uint16_t>(sum >> BLUR_COLUMNS_SHIFT);
+    }
+}
+
+void BlurRowScalar(const uint16_t* values, const int16_t* weights, size_t taps, uint8_t* row, size_t begin,
+                   size_t size) {
+    for (size_t b = begin; b < size; ++b) {
+        int32_t sum = 0;
+        for (size_t k = 0; k < taps; ++k) {
+            sum += weights[k] * values[b + k * image::utils::BYTES_PER_PIXEL];
+        }
+        row[b] = static_cast<uint8_t>(sum >> BLUR_ROW_SHIFT);
+    }
+}
+
+void BlurColumnsScalar(const uint8_t* const* rows, const int16_t* weights, size_t taps, uint16_t* values,
+                       size_t size) {
+    BlurColumnsScalar(rows, weights, taps, values, 0, size);
+}
+
+void BlurRowScalar(const uint16_t* values, const int16_t* weights, size_t taps, uint8_t* row, size_t size) {
+    BlurRowScalar(values, weights, taps, row, 0, size);
+}
+
+#ifdef IMAGE_PROCESSOR_X86_KERNELS
+// The grayscale kernels work on 128-bit lanes holding 4 pixels (12 bytes) each, loaded
+// 16 bytes at a time. In every lane the blue and green bytes are widened into 16-bit pairs
+// and the red ones into (red, 0) pairs, so one madd per pair gives the weighted sums as
+// 32-bit integers. The grays are then spread back over 12 bytes; the last 4 bytes of a
+// lane keep their loaded value, so a store never changes pixels it hasn't processed yet.
+const int LANE_PIXELS = 4;
+// A lane load reads 16 bytes, so it needs 6 pixels from its start to stay within the row.
+const int LANE_LOAD_PIXELS = 6;
+
+#define BLUE_GREEN_MASK 0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1
+#define RED_MASK 2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1
+#define SPREAD_MASK 0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, 12, 13, 14, 15
+#define BLUE_GREEN_WEIGHTS                                                                                  \
+    image::utils::BLUE_WEIGHT, image::utils::GREEN_WEIGHT, image::utils::BLUE_WEIGHT, image::utils::GREEN_WEIGHT, \
+        image::utils::BLUE_WEIGHT, image::utils::GREEN_WEIGHT, image::utils::BLUE_WEIGHT, image::utils::GREEN_WEIGHT
+#define RED_WEIGHTS image::utils::RED_WEIGHT, 0, image::utils::RED_WEIGHT, 0, image::utils::RED_WEIGHT, 0, \
+                    image::utils::RED_WEIGHT, 0
+
+__attribute__((target("sse4.1"))) inline __m128i GrayscaleLane(__m128i pixels) {
+    const __m128i blue_green_mask = _mm_setr_epi8(BLUE_GREEN_MASK);
+    const __m128i red_mask = _mm_setr_epi8(RED_MASK);
+    const __m128i spread_mask = _mm_setr_epi8(SPREAD_MASK);
+    const __m128i blue_green_weights = _mm_setr_epi16(BLUE_GREEN_WEIGHTS);
+    const __m128i red_weights = _mm_setr_epi16(RED_WEIGHTS);
+
+    __m128i sums = _mm_add_epi32(_mm_madd_epi16(_mm_shuffle_epi8(pixels, blue_green_mask), blue_green_weights),
+                                 _mm_madd_epi16(_mm_shuffle_epi8(pixels, red_mask), red_weights));
+    __m128i grays = _mm_srli_epi32(sums, image::utils::GRAY_SHIFT);
+    // Bytes 12..15 of grays are zero, put the loaded ones back.
+    return _mm_blend_epi16(_mm_shuffle_epi8(grays, spread_mask), pixels, 0xC0);
+}
+
+__attribute__((target("sse4.1"))) void GrayscaleRowSse41(const Color* row, Color* new_row, size_t width) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row);
+    uint8_t* new_bytes = reinterpret_cast<uint8_t*>(new_row);
+    size_t j = 0;
+    for (; j + LANE_LOAD_PIXELS <= width; j += LANE_PIXELS) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + j * sizeof(Color)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(new_bytes + j * sizeof(Color)), GrayscaleLane(pixels));
+    }
+    GrayscaleRowScalar(row + j, new_row + j, width - j);
+}
+
+__attribute__((target("avx2"))) void GrayscaleRowAvx2(const Color* row, Color* new_row, size_t width) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row);
+    uint8_t* new_bytes = reinterpret_cast<uint8_t*>(new_row);
+    const __m256i blue_green_mask = _mm256_setr_epi8(BLUE_GREEN_MASK, BLUE_GREEN_MASK);
+    const __m256i red_mask = _mm256_setr_epi8(RED_MASK, RED_MASK);
+    const __m256i spread_mask = _mm256_setr_epi8(SPREAD_MASK, SPREAD_MASK);
+    const __m256i blue_green_weights = _mm256_setr_epi16(BLUE_GREEN_WEIGHTS, BLUE_GREEN_WEIGHTS);
+    const __m256i red_weights = _mm256_setr_epi16(RED_WEIGHTS, RED_WEIGHTS);
+    const size_t lane_size = LANE_PIXELS * sizeof(Color);
+
+    size_t j = 0;
+    for (; j + LANE_PIXELS + LANE_LOAD_PIXELS <= width; j += 2 * LANE_PIXELS) {
+        const uint8_t* source = bytes + j * sizeof(Color);
+        uint8_t* target = new_bytes + j * sizeof(Color);
+        __m256i pixels =
+            _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source))),
+                                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + lane_size)), 1);
+        __m256i sums =
+            _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi8(pixels, blue_green_mask), blue_green_weights),
+                             _mm256_madd_epi16(_mm256_shuffle_epi8(pixels, red_mask), red_weights));
+        __m256i grays = _mm256_srli_epi32(sums, image::utils::GRAY_SHIFT);
+        __m256i result = _mm256_blend_epi16(_mm256_shuffle_epi8(grays, spread_mask), pixels, 0xC0);
+        // The low lane goes first: its last 4 bytes are the unprocessed start of the high one.
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target), _mm256_castsi256_si128(result));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + lane_size), _mm256_extracti128_si256(result, 1));
+    }
+    GrayscaleRowSse41(row + j, new_row + j, width - j);
+}
+
+__attribute__((target("avx512f,avx512bw"))) void GrayscaleRowAvx512(const Color* row, Color* new_row,
+                                                                     size_t width) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row);
+    uint8_t* new_bytes = reinterpret_cast<uint8_t*>(new_row);
+    const __m512i blue_green_mask = _mm512_maskz_broadcast_i32x4(ALL_DWORDS, _mm_setr_epi8(BLUE_GREEN_MASK));
+    const __m512i red_mask = _mm512_maskz_broadcast_i32x4(ALL_DWORDS, _mm_setr_epi8(RED_MASK));
+    const __m512i spread_mask = _mm512_maskz_broadcast_i32x4(ALL_DWORDS, _mm_setr_epi8(SPREAD_MASK));
+    const __m512i blue_green_weights = _mm512_maskz_broadcast_i32x4(ALL_DWORDS, _mm_setr_epi16(BLUE_GREEN_WEIGHTS));
+    const __m512i red_weights = _mm512_maskz_broadcast_i32x4(ALL_DWORDS, _mm_setr_epi16(RED_WEIGHTS));
+    // Bytes 12..15 of every lane.
+    const __mmask64 kept_bytes = 0xF000F000F000F000ULL;
+    const size_t lane_size = LANE_PIXELS * sizeof(Color);
+
+    size_t j = 0;
+    for (; j + 3 * LANE_PIXELS + LANE_LOAD_PIXELS <= width; j += 4 * LANE_PIXELS) {
+        const uint8_t* source = bytes + j * sizeof(Color);
+        uint8_t* target = new_bytes + j * sizeof(Color);
+        __m512i pixels = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source)));
+        pixels = _mm512_inserti32x4(pixels, _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + lane_size)), 1);
+        pixels =
+            _mm512_inserti32x4(pixels, _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 2 * lane_size)), 2);
+        pixels =
+            _mm512_inserti32x4(pixels, _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3 * lane_size)), 3);
+        __m512i sums =
+            _mm512_add_epi32(_mm512_madd_epi16(_mm512_shuffle_epi8(pixels, blue_green_mask), blue_green_weights),
+                             _mm512_madd_epi16(_mm512_shuffle_epi8(pixels, red_mask), red_weights));
+        __m512i grays = _mm512_maskz_srli_epi32(ALL_DWORDS, sums, image::utils::GRAY_SHIFT);
+        __m512i result = _mm512_mask_blend_epi8(kept_bytes, _mm512_shuffle_epi8(grays, spread_mask), pixels);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target), _mm512_maskz_extracti32x4_epi32(ALL_LANES, result, 0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + lane_size),
+                         _mm512_maskz_extracti32x4_epi32(ALL_LANES, result, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + 2 * lane_size),
+                         _mm512_maskz_extracti32x4_epi32(ALL_LANES, result, 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + 3 * lane_size),
+                         _mm512_maskz_extracti32x4_epi32(ALL_LANES, result, 3));
+    }
+    GrayscaleRowAvx2(row + j, new_row + j, width - j);
+}
+
+#undef BLUE_GREEN_MASK
+#undef RED_MASK
+#undef SPREAD_MASK
+#undef BLUE_GREEN_WEIGHTS
+#undef RED_WEIGHTS
+
+// Negative doesn't care about pixel boundaries: it flips every byte of the row.
+__attribute__((target("sse4.1"))) void NegativeRowSse41(const Color* row, Color* new_row, size_t width) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row);
+    uint8_t* new_bytes = reinterpret_cast<uint8_t*>(new_row);
+    const size_t size = width * sizeof(Color);
+    const __m128i ones = _mm_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + sizeof(__m128i) <= size; i += sizeof(__m128i)) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(new_bytes + i), _mm_xor_si128(values, ones));
+    }
+    NegativeBytesScalar(bytes + i, new_bytes + i, size - i);
+}
+
+__attribute__((target("avx2"))) void NegativeRowAvx2(const Color* row, Color* new_row, size_t width) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row);
+    uint8_t* new_bytes = reinterpret_cast<uint8_t*>(new_row);
+    const size_t size = width * sizeof(Color);
+    const __m256i ones = _mm256_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + sizeof(__m256i) <= size; i += sizeof(__m256i)) {
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(new_bytes + i), _mm256_xor_si256(values, ones));
+    }
+    NegativeBytesScalar(bytes + i, new_bytes + i, size - i);
+}
+
+__attribute__((target("avx512f"))) void NegativeRowAvx512(const Color* row, Color* new_row, size_t width) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row);
+    uint8_t* new_bytes = reinterpret_cast<uint8_t*>(new_row);
+    const size_t size = width * sizeof(Color);
+    const __m512i ones = _mm512_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + sizeof(__m512i) <= size; i += sizeof(__m512i)) {
+        __m512i values = _mm512_loadu_si512(bytes + i);
+        _mm512_storeu_si512(new_bytes + i, _mm512_xor_si512(values, ones));
+    }
+    NegativeBytesScalar(bytes + i, new_bytes + i, size - i);
+}
+
+// The vector blur passes take taps two at a time: the values of both are interleaved into
+// 16-bit pairs and one madd with the pair of weights adds both products to 32-bit sums.
+// An odd last tap is paired with itself and a zero weight. Unpacking and packing both work
+// within 128-bit lanes, so the packed sums come out in the order of the values.
+inline int32_t GetWeightPair(const int16_t* weights, size_t taps, size_t k) {
+    const uint16_t second = k + 1 < taps ? static_cast<uint16_t>(weights[k + 1]) : 0;
+    return static_cast<int32_t>(static_cast<uint32_t>(second) << 16 | static_cast<uint16_t>(weights[k]));
+}
+
+__attribute__((target("sse4.1"))) void BlurColumnsSse41(const uint8_t* const* rows, const int16_t* weights,
+                                                        size_t taps, uint16_t* values, size_t size) {
+    const __m128i rounding = _mm_set1_epi32(1 << (BLUR_COLUMNS_SHIFT - 1));
+    const size_t step = sizeof(__m128i) / sizeof(uint16_t);
+    size_t b = 0;
+    for (; b + step <= size; b += step) {
+        __m128i low = rounding;
+        __m128i high = rounding;
+        for (size_t k = 0; k < taps; k += 2) {
+            const __m128i pair = _mm_set1_epi32(GetWeightPair(weights, taps, k));
+            const __m128i first = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[k] + b)));
+            const __m128i second = _mm_cvtepu8_epi16(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[std::min(k + 1, taps - 1)] + b)));
+            low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(first, second), pair));
+            high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(first, second), pair));
+        }
+        const __m128i result = _mm_packus_epi32(_mm_srai_epi32(low, BLUR_COLUMNS_SHIFT),
+                                                _mm_srai_epi32(high, BLUR_COLUMNS_SHIFT));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + b), result);
+    }
+    BlurColumnsScalar(rows, weights, taps, values, b, size);
+}
+
+__attribute__((target("sse4.1"))) void BlurRowSse41(const uint16_t* values, const int16_t* weights, size_t taps,
+                                                    uint8_t* row, size_t size) {
+    const size_t step = sizeof(__m128i) / sizeof(uint16_t);
+    size_t b = 0;
+    for (; b + step <= size; b += step) {
+        __m128i low = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+        for (size_t k = 0; k < taps; k += 2) {
+            const __m128i pair = _mm_set1_epi32(GetWeightPair(weights, taps, k));
+            const uint16_t* source = values + b + k * image::utils::BYTES_PER_PIXEL;
+            const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+            const __m128i second = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(k + 1 < taps ? source + image::utils::BYTES_PER_PIXEL : source));
+            low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(first, second), pair));
+            high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(first, second), pair));
+        }
+        const __m128i words =
+            _mm_packus_epi32(_mm_srai_epi32(low, BLUR_ROW_SHIFT), _mm_srai_epi32(high, BLUR_ROW_SHIFT));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + b), _mm_packus_epi16(words, words));
+    }
+    BlurRowScalar(values, weights, taps, row, b, size);
+}
+
+__attribute__((target("avx2"))) void BlurColumnsAvx2(const uint8_t* const* rows, const int16_t* weights, size_t taps,
+                                                     uint16_t* values, size_t size) {
+    const __m256i rounding = _mm256_set1_epi32(1 << (BLUR_COLUMNS_SHIFT - 1));
+    const size_t step = sizeof(__m256i) / sizeof(uint16_t);
+    size_t b = 0;
+    for (; b + step <= size; b += step) {
+        __m256i low = rounding;
+        __m256i high = rounding;
+        for (size_t k = 0; k < taps; k += 2) {
+            const __m256i pair = _mm256_set1_epi32(GetWeightPair(weights, taps, k));
+            const __m256i first =
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + b)));
+            const __m256i second = _mm256_cvtepu8_epi16(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[std::min(k + 1, taps - 1)] + b)));
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(first, second), pair));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(first, second), pair));
+        }
+        const __m256i result = _mm256_packus_epi32(_mm256_srai_epi32(low, BLUR_COLUMNS_SHIFT),
+                                                   _mm256_srai_epi32(high, BLUR_COLUMNS_SHIFT));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + b), result);
+    }
+    BlurColumnsScalar(rows, weights, taps, values, b, size);
+}
+
+__attribute__((target("avx2"))) void BlurRowAvx2(const uint16_t* values, const int16_t* weights, size_t taps,
+                                                 uint8_t* row, size_t size) {
+    const size_t step = sizeof(__m256i) / sizeof(uint16_t);
+    size_t b = 0;
+    for (; b + step <= size; b += step) {
+        __m256i low = _mm256_setzero_si256();
+        __m256i high = _mm256_setzero_si256();
+        for (size_t k = 0; k < taps; k += 2) {
+            const __m256i pair = _mm256_set1_epi32(GetWeightPair(weights, taps, k));
+            const uint16_t* source = values + b + k * image::utils::BYTES_PER_PIXEL;
+            const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+            const __m256i second = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(k + 1 < taps ? source + image::utils::BYTES_PER_PIXEL : source));
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(first, second), pair));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(first, second), pair));
+        }
+        const __m256i words =
+            _mm256_packus_epi32(_mm256_srai_epi32(low, BLUR_ROW_SHIFT), _mm256_srai_epi32(high, BLUR_ROW_SHIFT));
+        // Packing the words with themselves leaves the bytes in the low 64 bits of each lane.
+        const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + b), _mm256_castsi256_si128(bytes));
+    }
+    BlurRowScalar(values, weights, taps, row, b, size);
+}
+
+__attribute__((target("avx512f,avx512bw"))) void BlurColumnsAvx512(const uint8_t* const* rows,
+                                                                    const int16_t* weights, size_t taps,
+                                                                    uint16_t* values, size_t size) {
+    const __m512i rounding = _mm512_set1_epi32(1 << (BLUR_COLUMNS_SHIFT - 1));
+    const size_t step = sizeof(__m512i) / sizeof(uint16_t);
+    size_t b = 0;
+    for (; b + step <= size; b += step) {
+        __m512i low = rounding;
+        __m512i high = rounding;
+        for (size_t k = 0; k < taps; k += 2) {
+            const __m512i pair = _mm512_set1_epi32(GetWeightPair(weights, taps, k));
+            const __m512i first =
+                _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + b)));
+            const __m512i second = _mm512_cvtepu8_epi16(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[std::min(k + 1, taps - 1)] + b)));
+            low = _mm512_add_epi32(low, _mm512_madd_epi16(_mm512_unpacklo_epi16(first, second), pair));
+            high = _mm512_add_epi32(high, _mm512_madd_epi16(_mm512_unpackhi_epi16(first, second), pair));
+        }
+        const __m512i result = _mm512_packus_epi32(_mm512_maskz_srai_epi32(ALL_DWORDS, low, BLUR_COLUMNS_SHIFT),
+                                                   _mm512_maskz_srai_epi32(ALL_DWORDS, high, BLUR_COLUMNS_SHIFT));
+        _mm512_storeu_si512(values + b, result);
+    }
+    BlurColumnsScalar(rows, weights, taps, values, b, size);
+}
+
+__attribute__((target("avx512f,avx512bw"))) void BlurRowAvx512(const uint16_t* values, const int16_t* weights,
+                                                                size_t taps, uint8_t* row, size_t size) {
+    const size_t step = sizeof(__m512i) / sizeof(uint16_t);
+    size_t b = 0;
+    for (; b + step <= size; b += step) {
+        __m512i low = _mm512_setzero_si512();
+        __m512i high = _mm512_setzero_si512();
+        for (size_t k = 0; k < taps; k += 2) {
+            const __m512i pair = _mm512_set1_epi32(GetWeightPair(weights, taps, k));
+            const uint16_t* source = values + b + k * image::utils::BYTES_PER_PIXEL;
+            const __m512i first = _mm512_loadu_si512(source);
+            const __m512i second = _mm512_loadu_si512(k + 1 < taps ? source + image::utils::BYTES_PER_PIXEL : source);
+            low = _mm512_add_epi32(low, _mm512_madd_epi16(_mm512_unpacklo_epi16(first, second), pair));
+            high = _mm512_add_epi32(high, _mm512_madd_epi16(_mm512_unpackhi_epi16(first, second), pair));
+        }
+        const __m512i words = _mm512_packus_epi32(_mm512_maskz_srai_epi32(ALL_DWORDS, low, BLUR_ROW_SHIFT),
+                                                  _mm512_maskz_srai_epi32(ALL_DWORDS, high, BLUR_ROW_SHIFT));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + b), _mm512_maskz_cvtepi16_epi8(ALL_WORDS, words));
+    }
+    BlurRowScalar(values, weights, taps, row, b, size);
+}
+#endif
+
+KernelTable SelectKernels() {
+#ifdef IMAGE_PROCESSOR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return {"avx512", GrayscaleRowAvx512, NegativeRowAvx512, BlurColumnsAvx512, BlurRowAvx512};
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return {"avx2", GrayscaleRowAvx2, NegativeRowAvx2, BlurColumnsAvx2, BlurRowAvx2};
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return {"sse4.1", GrayscaleRowSse41, NegativeRowSse41, BlurColumnsSse41, BlurRowSse41};
+    }
+#endif
+    return {"scalar", GrayscaleRowScalar, NegativeRowScalar, BlurColumnsScalar, BlurRowScalar};
+}
+
+const KernelTable& GetKernels() {
+    static const KernelTable kernels = SelectKernels();
+    return kernels;
+}
+}  // namespace
+
+void GrayscaleRow(const Color* row, Color* new_row, size_t width) {
+    GetKernels().grayscale(row, new_row, width);
+}
+
+void NegativeRow(const Color* row, Color* new_row, size_t width) {
+    GetKernels().negative(row, new_row, width);
+}
+
+void BlurColumns(const uint8_t* const* rows, const int16_t* weights, size_t taps, uint16_t* values, size_t size) {
+    GetKernels().blur_columns(rows, weights, taps, values, size);
+}
+
+void BlurRow(const uint16_t* values, const int16_t* weights, size_t taps, uint8_t* row, size_t size) {
+    GetKernels().blur_row(values, weights, taps, row, size);
+}
+
+const char* GetInstructionSet() {
+    return GetKernels().instruction_set;
+}
+}  // namespace filters::kernels
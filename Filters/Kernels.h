@@ -0,0 +1,40 @@
+#ifndef CPP_HSE_KERNELS_H
+#define CPP_HSE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../Image/Color.h"
+#include "../Reading_and_writing/Utils.h"
+
+// Row kernels over packed BGR24 pixels. Every kernel has a scalar version and, on x86,
+// SSE4.1, AVX2 and AVX-512 versions; the best one the CPU supports is picked at the first
+// call. All versions give identical results. row and new_row may be the same row.
+namespace filters::kernels {
+inline uint8_t Gray(uint8_t blue, uint8_t green, uint8_t red) {
+    return static_cast<uint8_t>((image::utils::RED_WEIGHT * red + image::utils::GREEN_WEIGHT * green +
+                                 image::utils::BLUE_WEIGHT * blue) >>
+                                image::utils::GRAY_SHIFT);
+}
+
+void GrayscaleRow(const Color* row, Color* new_row, size_t width);
+void NegativeRow(const Color* row, Color* new_row, size_t width);
+
+// The two passes of a fixed-point separable blur over rows of bytes, whatever pixels they
+// belong to. Weights are non-negative and sum to 1 << BLUR_WEIGHT_BITS. The vertical pass
+// keeps BLUR_FRACTION_BITS of fraction in 16-bit values for the horizontal one, whose
+// sums are truncated to bytes. Sums are exact in 32 bits, so every version agrees.
+const int BLUR_WEIGHT_BITS = 14;
+const int BLUR_FRACTION_BITS = 6;
+
+// values[b] = sum of weights[k] * rows[k][b] over taps rows, for size bytes.
+void BlurColumns(const uint8_t* const* rows, const int16_t* weights, size_t taps, uint16_t* values, size_t size);
+// row[b] = sum of weights[k] * values[b + k * BYTES_PER_PIXEL] over taps, for size bytes, so
+// values holds (taps - 1) * BYTES_PER_PIXEL more than size of them.
+void BlurRow(const uint16_t* values, const int16_t* weights, size_t taps, uint8_t* row, size_t size);
+
+// Name of the instruction set the kernels run on: "avx512", "avx2", "sse4.1" or "scalar".
+const char* GetInstructionSet();
+}  // namespace filters::kernels
+
+#endif  // CPP_HSE_KERNELS_H
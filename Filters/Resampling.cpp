@@ -0,0 +1,106 @@
+#include "Resampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+// Keys' cubic convolution with a = -0.5, which interpolates and reproduces quadratics.
+const double BICUBIC_A = -0.5;
+const double LANCZOS_LOBES = 3;
+const double PI = 3.14159265358979323846;
+
+double GetSupport(filters::ResamplingKernel kernel) {
+    switch (kernel) {
+        case filters::ResamplingKernel::BILINEAR:
+            return 1;
+        case filters::ResamplingKernel::BICUBIC:
+            return 2;
+        case filters::ResamplingKernel::LANCZOS3:
+            return LANCZOS_LOBES;
+    }
+    return 0;
+}
+
+double Sinc(double x) {
+    if (x == 0) {
+        return 1;
+    }
+    const double angle = PI * x;
+    return std::sin(angle) / angle;
+}
+
+double Evaluate(filters::ResamplingKernel kernel, double x) {
+    x = std::abs(x);
+    switch (kernel) {
+        case filters::ResamplingKernel::BILINEAR:
+            return std::max(0.0, 1 - x);
+        case filters::ResamplingKernel::BICUBIC:
+            if (x < 1) {
+                return ((BICUBIC_A + 2) * x - (BICUBIC_A + 3)) * x * x + 1;
+            }
+            if (x < 2) {
+                return ((BICUBIC_A * x - 5 * BICUBIC_A) * x + 8 * BICUBIC_A) * x - 4 * BICUBIC_A;
+            }
+            return 0;
+        case filters::ResamplingKernel::LANCZOS3:
+            return x < LANCZOS_LOBES ? Sinc(x) * Sinc(x / LANCZOS_LOBES) : 0;
+    }
+    return 0;
+}
+}  // namespace
+
+filters::ResamplingWeights::ResamplingWeights(ResamplingKernel kernel, size_t input_size, size_t output_size)
+    : starts_(output_size) {
+    const double ratio = static_cast<double>(input_size) / static_cast<double>(output_size);
+    const double scale = std::max(1.0, ratio);
+    const double support = GetSupport(kernel) * scale;
+    const auto last_input = static_cast<std::ptrdiff_t>(input_size) - 1;
+    // Weights of every output position over input positions [firsts[i], firsts[i] + phases[i].size()).
+    std::vector<std::vector<double>> phases(output_size);
+    std::vector<size_t> firsts(output_size);
+    for (size_t i = 0; i < output_size; ++i) {
+        // Pixel j covers [j, j + 1) and has its centre at j + 0.5, in both images.
+        const double center = (static_cast<double>(i) + 0.5) * ratio;
+        const auto low = static_cast<std::ptrdiff_t>(std::floor(center - support));
+        const auto high = static_cast<std::ptrdiff_t>(std::ceil(center + support));
+        std::ptrdiff_t first = last_input;
+        std::ptrdiff_t last = 0;
+        std::vector<std::pair<std::ptrdiff_t, double>> taps;
+        for (std::ptrdiff_t j = low; j <= high; ++j) {
+            const double weight = Evaluate(kernel, (static_cast<double>(j) + 0.5 - center) / scale);
+            if (weight != 0) {
+                const std::ptrdiff_t index = std::clamp<std::ptrdiff_t>(j, 0, last_input);
+                taps.emplace_back(index, weight);
+                first = std::min(first, index);
+                last = std::max(last, index);
+            }
+        }
+        // The input pixel nearest to the centre always has a positive weight.
+        std::vector<double>& phase = phases[i];
+        phase.assign(static_cast<size_t>(last - first + 1), 0);
+        double sum = 0;
+        for (const auto& [index, weight] : taps) {
+            phase[static_cast<size_t>(index - first)] += weight;
+            sum += weight;
+        }
+        for (double& weight : phase) {
+            weight /= sum;
+        }
+        firsts[i] = static_cast<size_t>(first);
+    }
+    // Windows get the same number of taps and never start before the one of an earlier
+    // position, so users can slide over the input. A window with zero weights trimmed off
+    // may start past the next one, it starts earlier then, as do the ones at the end of
+    // the input. Both get leading zeros.
+    for (size_t i = output_size; i-- > 0;) {
+        starts_[i] = i + 1 < output_size ? std::min(firsts[i], starts_[i + 1]) : firsts[i];
+        taps_ = std::max(taps_, firsts[i] + phases[i].size() - starts_[i]);
+    }
+    weights_.assign(output_size * taps_, 0);
+    for (size_t i = 0; i < output_size; ++i) {
+        starts_[i] = std::min(starts_[i], input_size - taps_);
+        std::transform(phases[i].begin(), phases[i].end(), weights_.begin() + i * taps_ + (firsts[i] - starts_[i]),
+                       [](double weight) { return static_cast<float>(weight); });
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef CPP_HSE_RESAMPLING_H
+#define CPP_HSE_RESAMPLING_H
+
+#include <cstddef>
+#include <vector>
+
+namespace filters {
+enum class ResamplingKernel { BILINEAR, BICUBIC, LANCZOS3 };
+
+// Weights for resampling a line of input_size values to output_size values, one phase per
+// output position, computed once for every line of an image. Output value i is the sum of
+// GetWeights(i)[k] * input[GetStart(i) + k] over k < GetTaps(). The kernel is centred on
+// the output position mapped back to the input and, when shrinking, stretched by the
+// scale, so every output value averages all the input values it covers. Past the edges
+// the input repeats its edge values; those weights are folded into the edge ones, so
+// every window lies within the input. The weights of every position add up to 1, and
+// windows move forwards: GetStart never decreases.
+class ResamplingWeights {
+public:
+    ResamplingWeights(ResamplingKernel kernel, size_t input_size, size_t output_size);
+
+    size_t GetTaps() const {
+        return taps_;
+    }
+    size_t GetStart(size_t i) const {
+        return starts_[i];
+    }
+    const float* GetWeights(size_t i) const {
+        return weights_.data() + i * taps_;
+    }
+
+private:
+    size_t taps_ = 0;
+    std::vector<size_t> starts_;
+    std::vector<float> weights_;
+};
+}  // namespace filters
+
+#endif  // CPP_HSE_RESAMPLING_H
@@ -0,0 +1,67 @@
+#ifndef CPP_HSE_STENCIL_H
+#define CPP_HSE_STENCIL_H
+
+#include <array>
+#include <cstddef>
+
+#include "../Image/Color.h"
+
+// 3x3 stencils with the matrix known at compile time. Taps with zero weight are dropped
+// while compiling, the interior of a row runs without any index clamping and only the
+// first and last pixels take the border path. Rows outside of the image are handled by
+// the caller, which passes the clamped neighbouring rows.
+namespace filters::stencil {
+using Matrix3x3 = std::array<std::array<int, 3>, 3>;
+
+struct Sums {
+    int blue = 0;
+    int green = 0;
+    int red = 0;
+};
+
+template <const Matrix3x3& Matrix, size_t I, size_t J>
+inline void AddTap(Sums& sums, const Color& color) {
+    if constexpr (Matrix[I][J] != 0) {
+        sums.blue += Matrix[I][J] * color.blue;
+        sums.green += Matrix[I][J] * color.green;
+        sums.red += Matrix[I][J] * color.red;
+    }
+}
+
+template <const Matrix3x3& Matrix, size_t I>
+inline void AddRowTaps(Sums& sums, const Color* row, size_t left, size_t center, size_t right) {
+    AddTap<Matrix, I, 0>(sums, row[left]);
+    AddTap<Matrix, I, 1>(sums, row[center]);
+    AddTap<Matrix, I, 2>(sums, row[right]);
+}
+
+template <const Matrix3x3& Matrix>
+inline Sums Convolve(const Color* above, const Color* row, const Color* below, size_t left, size_t center,
+                     size_t right) {
+    Sums sums;
+    AddRowTaps<Matrix, 0>(sums, above, left, center, right);
+    AddRowTaps<Matrix, 1>(sums, row, left, center, right);
+    AddRowTaps<Matrix, 2>(sums, below, left, center, right);
+    return sums;
+}
+
+// Calls store(new_row[j], sums) with the weighted sums of every pixel of row. new_row
+// must not overlap above, row or below.
+template <const Matrix3x3& Matrix, typename Store>
+void ApplyToRow(const Color* above, const Color* row, const Color* below, size_t width, Color* new_row,
+                Store&& store) {
+    if (width == 0) {
+        return;
+    }
+    const size_t last = width - 1;
+    store(new_row[0], Convolve<Matrix>(above, row, below, 0, 0, last == 0 ? 0 : 1));
+    for (size_t j = 1; j < last; ++j) {
+        store(new_row[j], Convolve<Matrix>(above, row, below, j - 1, j, j + 1));
+    }
+    if (last > 0) {
+        store(new_row[last], Convolve<Matrix>(above, row, below, last - 1, last, last));
+    }
+}
+}  // namespace filters::stencil
+
+#endif  // CPP_HSE_STENCIL_H
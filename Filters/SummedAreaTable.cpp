@@ -0,0 +1,25 @@
+#include "SummedAreaTable.h"
+
+#include <algorithm>
+
+void filters::SummedAreaTable::Build(const Image& image, size_t begin, size_t end) {
+    begin_ = begin;
+    width_ = image.GetWidth();
+    const size_t row_size = width_ + 1;
+    table_.resize((end - begin + 1) * row_size);
+    std::fill(table_.begin(), table_.begin() + static_cast<std::ptrdiff_t>(row_size), Sums());
+    for (size_t i = begin; i < end; ++i) {
+        const Color* row = image.GetRow(i);
+        const Sums* above = table_.data() + (i - begin) * row_size;
+        Sums* sums = table_.data() + (i - begin + 1) * row_size;
+        Sums row_sums;
+        sums[0] = row_sums;
+        for (size_t j = 0; j < width_; ++j) {
+            row_sums.blue += row[j].blue;
+            row_sums.green += row[j].green;
+            row_sums.red += row[j].red;
+            sums[j + 1] = {above[j + 1].blue + row_sums.blue, above[j + 1].green + row_sums.green,
+                           above[j + 1].red + row_sums.red};
+        }
+    }
+}
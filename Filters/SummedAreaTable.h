@@ -0,0 +1,49 @@
+#ifndef CPP_HSE_SUMMED_AREA_TABLE_H
+#define CPP_HSE_SUMMED_AREA_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../Image/Image.h"
+
+namespace filters {
+// Channel sums over rows [begin, end) of an image, laid out so that the sum over any
+// rectangle of them takes four lookups whatever its size. Entry (i, j) holds the sums over
+// rows [begin, begin + i) and columns [0, j). The sums are 64-bit, so no image that fits in
+// memory overflows them. Filters building a table for part of an image at a time keep
+// its memory to that part, and reuse it by building the next part into the same table.
+class SummedAreaTable {
+public:
+    struct Sums {
+        uint64_t blue = 0;
+        uint64_t green = 0;
+        uint64_t red = 0;
+    };
+
+    void Build(const Image& image, size_t begin, size_t end);
+
+    // Sums over rows [top, bottom) and columns [left, right) of the image, which must be
+    // within the rows the table was built for.
+    Sums GetSums(size_t top, size_t left, size_t bottom, size_t right) const {
+        const Sums& top_left = At(top - begin_, left);
+        const Sums& top_right = At(top - begin_, right);
+        const Sums& bottom_left = At(bottom - begin_, left);
+        const Sums& bottom_right = At(bottom - begin_, right);
+        return {bottom_right.blue - bottom_left.blue - top_right.blue + top_left.blue,
+                bottom_right.green - bottom_left.green - top_right.green + top_left.green,
+                bottom_right.red - bottom_left.red - top_right.red + top_left.red};
+    }
+
+private:
+    const Sums& At(size_t row, size_t column) const {
+        return table_[row * (width_ + 1) + column];
+    }
+
+    size_t begin_ = 0;
+    size_t width_ = 0;
+    std::vector<Sums> table_;
+};
+}  // namespace filters
+
+#endif  // CPP_HSE_SUMMED_AREA_TABLE_H
@@ -0,0 +1,176 @@
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+// Size classes split every power of two into this many steps.
+const std::size_t CLASSES_PER_DOUBLING = 4;
+
+std::size_t RoundUp(std::size_t size, std::size_t step) {
+    return (size + step - 1) / step * step;
+}
+
+void TouchPages(void* data, std::size_t size) {
+    const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    auto* bytes = static_cast<volatile unsigned char*>(data);
+    for (std::size_t offset = 0; offset < size; offset += page_size) {
+        bytes[offset] = 0;
+    }
+}
+}  // namespace
+
+BufferPool::~BufferPool() {
+    Trim();
+}
+
+BufferPool::Buffer BufferPool::Acquire(std::size_t size) {
+    if (size == 0) {
+        return {};
+    }
+    const std::size_t size_class = GetSizeClass(size);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (size_class >= MIN_POOLED_SIZE) {
+            auto it = std::find_if(held_.rbegin(), held_.rend(),
+                                   [size_class](const Buffer& buffer) { return buffer.size == size_class; });
+            if (it != held_.rend()) {
+                Buffer buffer = *it;
+                held_.erase(std::next(it).base());
+                ++stats_.hits;
+                stats_.reused_bytes += buffer.size;
+                stats_.held_bytes -= buffer.size;
+                --stats_.held_buffers;
+                return buffer;
+            }
+        }
+        ++stats_.misses;
+        stats_.allocated_bytes += size_class;
+    }
+    return Allocate(size_class);
+}
+
+void BufferPool::Release(void* data, std::size_t size) {
+    if (data == nullptr) {
+        return;
+    }
+    const Buffer buffer{data, GetSizeClass(size)};
+    if (buffer.size >= MIN_POOLED_SIZE) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (buffer.size <= retained_limit_) {
+            Evict(retained_limit_ - buffer.size);
+            held_.push_back(buffer);
+            stats_.held_bytes += buffer.size;
+            ++stats_.held_buffers;
+            return;
+        }
+    }
+    Free(buffer);
+}
+
+void BufferPool::SetRetainedLimit(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retained_limit_ = bytes;
+    Evict(bytes);
+}
+
+void BufferPool::SetHugePages(bool huge_pages) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    huge_pages_ = huge_pages;
+}
+
+void BufferPool::SetPrefault(bool prefault) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    prefault_ = prefault;
+}
+
+void BufferPool::Trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Evict(0);
+}
+
+BufferPool::Stats BufferPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::size_t BufferPool::GetSizeClass(std::size_t size) {
+    if (size < MIN_POOLED_SIZE) {
+        return RoundUp(size, ALIGNMENT);
+    }
+    std::size_t power = MIN_POOLED_SIZE;
+    while (power * 2 <= size) {
+        power *= 2;
+    }
+    const std::size_t size_class = RoundUp(size, power / CLASSES_PER_DOUBLING);
+    return size_class >= HUGE_PAGE_SIZE ? RoundUp(size_class, HUGE_PAGE_SIZE) : size_class;
+}
+
+BufferPool::Buffer BufferPool::Allocate(std::size_t size) {
+    if (size < HUGE_PAGE_SIZE) {
+        return {::operator new(size, std::align_val_t(ALIGNMENT)), size};
+    }
+    bool huge_pages = false;
+    bool prefault = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        huge_pages = huge_pages_;
+        prefault = prefault_;
+    }
+    // mmap only aligns to pages: map one huge page more and unmap the unaligned ends.
+    void* mapping = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    auto* begin = static_cast<unsigned char*>(mapping);
+    auto* data = reinterpret_cast<unsigned char*>(RoundUp(reinterpret_cast<std::uintptr_t>(begin), HUGE_PAGE_SIZE));
+    if (data != begin) {
+        munmap(begin, static_cast<std::size_t>(data - begin));
+    }
+    const std::size_t tail = HUGE_PAGE_SIZE - static_cast<std::size_t>(data - begin);
+    if (tail > 0) {
+        munmap(data + size, tail);
+    }
+    if (huge_pages) {
+        madvise(data, size, MADV_HUGEPAGE);
+    }
+    if (prefault) {
+#ifdef MADV_POPULATE_WRITE
+        if (madvise(data, size, MADV_POPULATE_WRITE) != 0) {
+            TouchPages(data, size);
+        }
+#else
+        TouchPages(data, size);
+#endif
+    }
+    return {data, size};
+}
+
+void BufferPool::Free(const Buffer& buffer) {
+    if (buffer.size >= HUGE_PAGE_SIZE) {
+        munmap(buffer.data, buffer.size);
+    } else {
+        ::operator delete(buffer.data, std::align_val_t(ALIGNMENT));
+    }
+}
+
+void BufferPool::Evict(std::size_t limit) {
+    auto end = held_.begin();
+    while (end != held_.end() && stats_.held_bytes > limit) {
+        Free(*end);
+        stats_.held_bytes -= end->size;
+        --stats_.held_buffers;
+        ++stats_.evictions;
+        ++end;
+    }
+    held_.erase(held_.begin(), end);
+}
+
+BufferPool& GetBufferPool() {
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
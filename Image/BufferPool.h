@@ -0,0 +1,82 @@
+#ifndef CPP_HSE_BUFFER_POOL_H
+#define CPP_HSE_BUFFER_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Keeps released pixel buffers and hands them out again, so stages and jobs that need
+// images of similar dimensions reuse memory whose pages are already mapped instead of
+// faulting in fresh ones. Sizes are rounded up to size classes four per power of two
+// apart, so a buffer fits any request up to a quarter smaller than it. Buffers of at least
+// HUGE_PAGE_SIZE bytes are mapped on their own, aligned to huge pages, and can be backed
+// by transparent huge pages and prefaulted in one go. Thread-safe.
+class BufferPool {
+public:
+    // Buffers are aligned to this many bytes.
+    static constexpr std::size_t ALIGNMENT = 64;
+    // Smaller buffers are cheap to allocate and are not kept.
+    static constexpr std::size_t MIN_POOLED_SIZE = 64 << 10;
+    static constexpr std::size_t HUGE_PAGE_SIZE = 2 << 20;
+    static constexpr std::size_t DEFAULT_RETAINED_LIMIT = std::size_t(1) << 30;
+
+    struct Buffer {
+        void* data = nullptr;
+        std::size_t size = 0;
+    };
+
+    struct Stats {
+        // Requests served with a kept buffer and requests that needed a new one.
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+        // Kept buffers freed to stay under the retained limit.
+        std::size_t evictions = 0;
+        std::size_t allocated_bytes = 0;
+        std::size_t reused_bytes = 0;
+        std::size_t held_bytes = 0;
+        std::size_t held_buffers = 0;
+    };
+
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    ~BufferPool();
+
+    // Returns a buffer of at least size bytes; its contents are unspecified.
+    Buffer Acquire(std::size_t size);
+    // Takes back a buffer from Acquire. size may be anything between the requested and the
+    // returned size.
+    void Release(void* data, std::size_t size);
+
+    // Kept buffers beyond this many bytes are freed, the least recently released first.
+    // 0 turns keeping buffers off.
+    void SetRetainedLimit(std::size_t bytes);
+    // Whether new large buffers are backed by transparent huge pages where the kernel
+    // supports it, and whether their pages are faulted in when they are allocated.
+    void SetHugePages(bool huge_pages);
+    void SetPrefault(bool prefault);
+    // Frees all kept buffers.
+    void Trim();
+
+    Stats GetStats() const;
+
+private:
+    static std::size_t GetSizeClass(std::size_t size);
+    Buffer Allocate(std::size_t size);
+    static void Free(const Buffer& buffer);
+    void Evict(std::size_t limit);
+
+    mutable std::mutex mutex_;
+    // Kept buffers, the least recently released first.
+    std::vector<Buffer> held_;
+    std::size_t retained_limit_ = DEFAULT_RETAINED_LIMIT;
+    bool huge_pages_ = false;
+    bool prefault_ = false;
+    Stats stats_;
+};
+
+// The pool all images allocate their pixels from. Never destroyed, so images with static
+// storage duration can outlive everything else.
+BufferPool& GetBufferPool();
+
+#endif  // CPP_HSE_BUFFER_POOL_H
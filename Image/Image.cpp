@@ -1,14 +1,64 @@
 #include "Image.h"
 
-Image::Image(std::size_t width, std::size_t height)
-    : width_(width), height_(height), pixels_(height, std::vector<Color>(width)) {
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "BufferPool.h"
+
+static_assert(BufferPool::ALIGNMENT % Image::ROW_ALIGNMENT == 0, "Pool buffers must be aligned like rows");
+
+Image::Image(std::size_t width, std::size_t height) {
+    Allocate(width, height);
+}
+
+Image::Image(const std::vector<std::vector<Color>>& data) {
+    Allocate(data.empty() ? 0 : data[0].size(), data.size());
+    for (std::size_t i = 0; i < height_; ++i) {
+        std::copy(data[i].begin(), data[i].begin() + static_cast<std::ptrdiff_t>(width_), GetRow(i));
+    }
 }
 
-Image::Image(const std::vector<std::vector<Color>>& data)
-    : width_(data[0].size()), height_(data.size()), pixels_(data) {
+Image::Image(const Image& other) {
+    Allocate(other.width_, other.height_);
+    for (std::size_t i = 0; i < height_; ++i) {
+        std::memcpy(GetRow(i), other.GetRow(i), width_ * sizeof(Color));
+    }
+}
+
+Image::Image(Image&& other) noexcept
+    : width_(std::exchange(other.width_, 0)),
+      height_(std::exchange(other.height_, 0)),
+      stride_(std::exchange(other.stride_, 0)),
+      capacity_(std::exchange(other.capacity_, 0)),
+      pixels_(std::exchange(other.pixels_, nullptr)) {
 }
 
-Image::Image(const Image& other) : width_(other.width_), height_(other.height_), pixels_(other.pixels_) {
+Image::~Image() {
+    Release();
+}
+
+Image& Image::operator=(const Image& other) {
+    if (this != &other) {
+        Reshape(other.width_, other.height_);
+        for (std::size_t i = 0; i < height_; ++i) {
+            std::memcpy(GetRow(i), other.GetRow(i), width_ * sizeof(Color));
+        }
+    }
+    return *this;
+}
+
+Image& Image::operator=(Image&& other) noexcept {
+    if (this != &other) {
+        Release();
+        width_ = std::exchange(other.width_, 0);
+        height_ = std::exchange(other.height_, 0);
+        stride_ = std::exchange(other.stride_, 0);
+        capacity_ = std::exchange(other.capacity_, 0);
+        pixels_ = std::exchange(other.pixels_, nullptr);
+    }
+    return *this;
 }
 
 std::size_t Image::GetWidth() const {
@@ -19,30 +69,99 @@ std::size_t Image::GetHeight() const {
     return height_;
 }
 
-const std::vector<std::vector<Color>>& Image::GetData() const {
-    return pixels_;
+std::size_t Image::GetStride() const {
+    return stride_;
 }
 
 const Color& Image::GetColor(std::size_t x, std::size_t y) const {
-    if (x >= height_ || y >= width_) {
-        throw std::out_of_range("Invalid coordinates");
-    }
-    return pixels_[x][y];
+    CheckCoordinates(x, y);
+    return GetRow(x)[y];
 }
 
 Color& Image::GetColor(std::size_t x, std::size_t y) {
-    if (x >= height_ || y >= width_) {
-        throw std::out_of_range("Invalid coordinates");
-    }
-    return pixels_[x][y];
+    CheckCoordinates(x, y);
+    return GetRow(x)[y];
 }
 
 void Image::SetColor(std::size_t x, std::size_t y, const Color& color) {
+    CheckCoordinates(x, y);
+    GetRow(x)[y] = color;
+}
+
+void Image::Reshape(std::size_t width, std::size_t height) {
+    if (GetAlignedStride(width) * height > capacity_) {
+        Release();
+        Allocate(width, height);
+        return;
+    }
+    width_ = width;
+    height_ = height;
+    stride_ = GetAlignedStride(width);
+}
+
+void Image::Truncate(std::size_t width, std::size_t height) {
+    if (width > width_ || height > height_) {
+        throw std::out_of_range("Truncated image can't be larger than the original");
+    }
+    width_ = width;
+    height_ = height;
+}
+
+void Image::ResizeRows(std::size_t height) {
+    if (stride_ * height <= capacity_) {
+        height_ = height;
+        return;
+    }
+    Image resized(width_, height);
+    for (std::size_t i = 0; i < height_; ++i) {
+        std::memcpy(resized.GetRow(i), GetRow(i), width_ * sizeof(Color));
+    }
+    *this = std::move(resized);
+}
+
+void Image::DropRows(std::size_t count) {
+    count = std::min(count, height_);
+    if (count > 0 && count < height_) {
+        std::memmove(pixels_, pixels_ + count * stride_, (height_ - count) * stride_ * sizeof(Color));
+    }
+    height_ -= count;
+}
+
+std::size_t Image::GetAlignedStride(std::size_t width) {
+    // ROW_ALIGNMENT is a power of two and sizeof(Color) is odd, so a row is aligned
+    // exactly when its pixel count is a multiple of ROW_ALIGNMENT.
+    return (width + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+}
+
+void Image::Allocate(std::size_t width, std::size_t height) {
+    width_ = width;
+    height_ = height;
+    stride_ = GetAlignedStride(width);
+    capacity_ = 0;
+    if (stride_ * height_ == 0) {
+        return;
+    }
+    BufferPool::Buffer buffer = GetBufferPool().Acquire(stride_ * height_ * sizeof(Color));
+    // The size class may leave room for more rows, which Reshape and ResizeRows can use.
+    capacity_ = buffer.size / sizeof(Color);
+    pixels_ = static_cast<Color*>(buffer.data);
+    std::uninitialized_default_construct_n(pixels_, stride_ * height_);
+}
+
+void Image::Release() {
+    if (pixels_ != nullptr) {
+        GetBufferPool().Release(pixels_, capacity_ * sizeof(Color));
+        pixels_ = nullptr;
+    }
+    capacity_ = 0;
+}
+
+void Image::CheckCoordinates(std::size_t x, std::size_t y) const {
     if (x >= height_ || y >= width_) {
         throw std::out_of_range("Invalid coordinates");
     }
-    pixels_[x][y] = color;
 }
+
 void Image::CheckWidthAndHeight(std::size_t width, std::size_t height) const {
     if (width == 0 || height == 0) {
         throw std::invalid_argument("Width and height must be greater than 0");
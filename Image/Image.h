@@ -1,31 +1,71 @@
 #ifndef CPP_HSE_IMAGE_H
 #define CPP_HSE_IMAGE_H
 
+#include <cassert>
 #include <stdexcept>
 #include <vector>
 
 #include "Color.h"
 
+static_assert(sizeof(Color) == 3, "Color must be a packed BGR triple");
+
+// Pixels are stored in one aligned contiguous buffer from the BufferPool, row after row. Every row starts
+// at a ROW_ALIGNMENT-byte boundary, so rows are GetStride() pixels apart in memory
+// (GetStride() >= GetWidth()). GetRow gives unchecked access for hot loops (checked by
+// assert in debug builds), GetColor and SetColor stay bounds-checked.
 class Image {
 public:
+    static constexpr std::size_t ROW_ALIGNMENT = 64;
+
     Image() = default;
     Image(std::size_t width, std::size_t height);
     explicit Image(const std::vector<std::vector<Color>>& data);
     Image(const Image& other);
-    ~Image() = default;
+    Image(Image&& other) noexcept;
+    ~Image();
+
+    Image& operator=(const Image& other);
+    Image& operator=(Image&& other) noexcept;
 
     std::size_t GetWidth() const;
     std::size_t GetHeight() const;
-    const std::vector<std::vector<Color>>& GetData() const;
+    std::size_t GetStride() const;
     const Color& GetColor(std::size_t x, std::size_t y) const;
     Color& GetColor(std::size_t x, std::size_t y);
 
+    const Color* GetRow(std::size_t x) const {
+        assert(x < height_);
+        return pixels_ + x * stride_;
+    }
+    Color* GetRow(std::size_t x) {
+        assert(x < height_);
+        return pixels_ + x * stride_;
+    }
+
     void SetColor(std::size_t x, std::size_t y, const Color& color);
 
+    // Changes the dimensions, reusing the current buffer when it is large enough. Pixel
+    // values are unspecified afterwards.
+    void Reshape(std::size_t width, std::size_t height);
+    // Keeps the top-left width x height part of the image without moving any pixels.
+    void Truncate(std::size_t width, std::size_t height);
+    // Changes the number of rows keeping the width and the pixels of the rows that remain.
+    // Added rows are unspecified.
+    void ResizeRows(std::size_t height);
+    // Removes the first count rows, moving the remaining ones up.
+    void DropRows(std::size_t count);
+
 private:
     std::size_t width_ = 0;
     std::size_t height_ = 0;
-    std::vector<std::vector<Color>> pixels_;
+    std::size_t stride_ = 0;
+    std::size_t capacity_ = 0;
+    Color* pixels_ = nullptr;
+
+    static std::size_t GetAlignedStride(std::size_t width);
+    void Allocate(std::size_t width, std::size_t height);
+    void Release();
+    void CheckCoordinates(std::size_t x, std::size_t y) const;
     void CheckWidthAndHeight(std::size_t width, std::size_t height) const;
 };
 
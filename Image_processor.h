@@ -1,20 +1,52 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+#include <filesystem>
 #include <iostream>
+#include <memory>
 
 #include "Filters/Filters.h"
 #include "Image/Image.h"
 #include "Parser/Parser.h"
+#include "Pipeline/Batch.h"
+#include "Pipeline/Cache.h"
+#include "Pipeline/Pipeline.h"
+#include "Pipeline/Planner.h"
+#include "Pipeline/Profiler.h"
+#include "Pipeline/Streaming.h"
 #include "Reading_and_writing/Reader.h"
 #include "Reading_and_writing/Writer.h"
+#include "Server/Server.h"
 
 std::vector<parser::Token> GetTokens(int argc, char* argv[]);
 
-Image GetImage(const std::string& path);
+Image GetImage(const std::string& path, const pipeline::FilterChain& chain, pipeline::Observer* observer = nullptr);
 
-void WriteImage(const std::string& path, const Image& image);
+void WriteImage(const std::string& path, const Image& image, const pipeline::FilterChain& chain,
+                pipeline::Observer* observer = nullptr);
 
-Image ApplyFilter(Image& image, const std::vector<parser::Token>& tokens);
+// Writes the levels of a pyramid of image next to path, every one built from the one
+// before and the last one left in image.
+void WritePyramid(const std::string& path, Image& image, const pipeline::FilterChain& chain, size_t levels,
+                  pipeline::Observer* observer = nullptr);
+
+// Loads the input whole, runs the filters on it and writes the output and its pyramid.
+void ProcessImage(const std::vector<parser::Token>& tokens, const pipeline::Options& options,
+                  pipeline::Observer* observer = nullptr);
+
+// Runs the filters on the input through the cache of options.cache_directory: copies the
+// output of an earlier run with the same input and filters, or goes on from the longest
+// prefix of the filters whose result is kept there, keeping what it computes. Falls back
+// to ProcessImage if the cache directory or the input can't be used.
+void ProcessCached(const std::vector<parser::Token>& tokens, const pipeline::Options& options,
+                   pipeline::Observer* observer = nullptr);
+
+void ApplyFilter(Image& image, const pipeline::FilterChain& chain, pipeline::Observer* observer = nullptr);
+
+void StreamFilter(const std::vector<parser::Token>& tokens, pipeline::Observer* observer = nullptr);
+
+void Serve(const std::vector<parser::Token>& tokens);
+
+void ProcessBatch(const std::vector<parser::Token>& tokens, const pipeline::Options& options);
 
 #endif
\ No newline at end of file
@@ -1,6 +1,15 @@
 #include "Parser.h"
 
+#include <cctype>
+
 namespace parser {
+namespace {
+// Arguments may be negative numbers, which aren't filter names even though they start with '-'.
+bool IsFilterName(const std::string& str) {
+    return str.front() == '-' && (str.size() == 1 || (!std::isdigit(static_cast<unsigned char>(str[1])) && str[1] != '.'));
+}
+}  // namespace
+
 void Token::Clear() {
     name.clear();
     args.clear();
@@ -20,7 +29,7 @@ std::vector<Token> Parse(int argc, char** argv) {
             tokens.push_back(curr);
             curr.Clear();
         } else {
-            if (str.front() == '-') {
+            if (IsFilterName(str)) {
                 if (!curr.Empty()) {
                     tokens.push_back(curr);
                     curr.Clear();
@@ -0,0 +1,108 @@
+#include "Batch.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+#include "Streaming.h"
+#include "../Reading_and_writing/Reader.h"
+#include "../Reading_and_writing/Writer.h"
+#include "../Threads/Scheduler.h"
+
+namespace pipeline {
+namespace {
+const char BATCH_COMMENT = '#';
+const std::vector<std::string> BATCH_EXTENSIONS = {".bmp", ".qoi", ".ppm", ".pgm", ".pnm"};
+
+bool HasBatchExtension(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return std::find(BATCH_EXTENSIONS.begin(), BATCH_EXTENSIONS.end(), extension) != BATCH_EXTENSIONS.end();
+}
+
+void ProcessFile(const FilterChain& chain, const BatchJob& job, bool stream) {
+    reading_and_writing::Reader reader(job.input);
+    reading_and_writing::Writer writer(job.output, GetOutputFormat(chain));
+    reader.Open();
+    PushDownCrop(chain, reader);
+    if (stream) {
+        RunStreaming(chain, reader, writer);
+        return;
+    }
+    Image image = reader.Read();
+    Run(chain, image);
+    writer.Write(image);
+}
+}  // namespace
+
+std::vector<BatchJob> ListBatchJobs(const std::string& input, const std::string& output_directory) {
+    const std::filesystem::path output_path(output_directory);
+    std::vector<BatchJob> jobs;
+    std::error_code error;
+    if (std::filesystem::is_directory(input, error)) {
+        for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(input)) {
+            if (entry.is_regular_file() && HasBatchExtension(entry.path())) {
+                jobs.push_back({entry.path().string(), (output_path / entry.path().filename()).string()});
+            }
+        }
+        std::sort(jobs.begin(), jobs.end(),
+                  [](const BatchJob& first, const BatchJob& second) { return first.input < second.input; });
+    } else {
+        std::ifstream manifest(input);
+        if (!manifest.is_open()) {
+            throw std::invalid_argument(std::string("Batch input ") + input + " is neither a directory nor a manifest");
+        }
+        std::string line;
+        while (std::getline(manifest, line)) {
+            std::istringstream fields(line);
+            fields >> std::ws;
+            BatchJob job;
+            if (fields.peek() == BATCH_COMMENT || !(fields >> std::quoted(job.input))) {
+                continue;
+            }
+            if (!(fields >> std::quoted(job.output))) {
+                job.output = (output_path / std::filesystem::path(job.input).filename()).string();
+            }
+            jobs.push_back(job);
+        }
+    }
+    std::filesystem::create_directories(output_path);
+    return jobs;
+}
+
+BatchSummary RunBatch(const FilterChain& chain, const std::vector<BatchJob>& jobs, bool stream, std::ostream& errors) {
+    const auto start = std::chrono::steady_clock::now();
+    BatchSummary summary;
+    summary.files = jobs.size();
+    std::mutex mutex;
+
+    std::vector<threads::RowBand> tasks;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        tasks.push_back({i, i, i + 1});
+    }
+    threads::ForEachBand(tasks, [&](const threads::RowBand& task) {
+        const BatchJob& job = jobs[task.index];
+        threads::SerialScope serial;
+        try {
+            ProcessFile(chain, job, stream);
+            std::error_code error;
+            const size_t size = std::filesystem::file_size(job.input, error);
+            std::lock_guard<std::mutex> lock(mutex);
+            summary.bytes += error ? 0 : size;
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++summary.failed;
+            errors << job.input << ": " << e.what() << std::endl;
+        }
+    });
+
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return summary;
+}
+}  // namespace pipeline
@@ -0,0 +1,39 @@
+#ifndef CPP_HSE_BATCH_H
+#define CPP_HSE_BATCH_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Pipeline.h"
+
+namespace pipeline {
+struct BatchJob {
+    std::string input;
+    std::string output;
+};
+
+struct BatchSummary {
+    size_t files = 0;
+    size_t failed = 0;
+    // Total size of the input files that were processed successfully.
+    size_t bytes = 0;
+    double seconds = 0;
+};
+
+// Lists the files to process. input is either a directory, all .bmp, .qoi, .ppm, .pgm and
+// .pnm files of which are processed, or a manifest: a text file with an input path per
+// line, optionally followed by an output path. Paths are separated by whitespace; paths
+// with whitespace in them are written in double quotes, in which \" and \\ stand for " and \:
+//   "scans/page 1.bmp" "out/page 1.bmp"
+// Empty lines and lines starting with # are skipped. Outputs without an explicit path go
+// to output_directory under the input's file name.
+std::vector<BatchJob> ListBatchJobs(const std::string& input, const std::string& output_directory);
+
+// Runs the chain over every job, several files at a time on the thread pool and each
+// file on a single thread. A file that fails is reported to errors and doesn't stop the
+// others.
+BatchSummary RunBatch(const FilterChain& chain, const std::vector<BatchJob>& jobs, bool stream, std::ostream& errors);
+}  // namespace pipeline
+
+#endif  // CPP_HSE_BATCH_H
@@ -0,0 +1,246 @@
+#include "Cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../Reading_and_writing/MappedFile.h"
+#include "../Reading_and_writing/Reader.h"
+#include "../Reading_and_writing/Writer.h"
+
+namespace pipeline {
+namespace {
+// Part of every key, to be changed when what is stored under a key changes.
+const char CACHE_VERSION[] = "1";
+const char STATISTICS_NAME[] = "stats";
+const char IMAGE_EXTENSION[] = ".qoi";
+
+// Primes and rounds of XXH64: four independent lanes take a word each from every 32
+// bytes, which runs at memory speed.
+const uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+const uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t PRIME_3 = 0x165667B19E3779F9ull;
+const uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t PRIME_5 = 0x27D4EB2F165667C5ull;
+
+uint64_t RotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t Round(uint64_t lane, uint64_t word) {
+    return RotateLeft(lane + word * PRIME_2, 31) * PRIME_1;
+}
+
+uint64_t Avalanche(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    return hash ^ (hash >> 32);
+}
+
+uint64_t LoadWord(const unsigned char* bytes) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+// 128 bits in hex, two differently mixed 64-bit digests of the four lanes.
+std::string HashBytes(const unsigned char* data, size_t size) {
+    uint64_t lanes[4] = {PRIME_1 + PRIME_2, PRIME_2, 0, 0 - PRIME_1};
+    size_t offset = 0;
+    for (; offset + 4 * sizeof(uint64_t) <= size; offset += 4 * sizeof(uint64_t)) {
+        for (size_t i = 0; i < 4; ++i) {
+            lanes[i] = Round(lanes[i], LoadWord(data + offset + i * sizeof(uint64_t)));
+        }
+    }
+    for (size_t i = 0; offset < size; ++i, offset += sizeof(uint64_t)) {
+        unsigned char tail[sizeof(uint64_t)] = {};
+        std::memcpy(tail, data + offset, std::min(sizeof(uint64_t), size - offset));
+        lanes[i] = Round(lanes[i], LoadWord(tail));
+    }
+    const uint64_t first = Avalanche(RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) +
+                                     RotateLeft(lanes[3], 18) + size * PRIME_5);
+    const uint64_t second = Avalanche((lanes[0] ^ RotateLeft(lanes[1], 17) ^ RotateLeft(lanes[2], 29) ^
+                                       RotateLeft(lanes[3], 41)) * PRIME_3 + size * PRIME_4);
+    std::ostringstream hex;
+    hex << std::hex << std::setfill('0') << std::setw(16) << first << std::setw(16) << second;
+    return hex.str();
+}
+
+std::string HashString(const std::string& text) {
+    return HashBytes(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+}
+
+// Names of the stages, with what they don't say: the weights of a convolution whose
+// kernel was read from a file.
+std::string DescribeStages(const std::string& input_hash, const FilterChain& chain, size_t stages) {
+    std::ostringstream description;
+    description << CACHE_VERSION << " " << input_hash << "\n" << std::hexfloat;
+    for (size_t i = 0; i < stages; ++i) {
+        description << chain[i]->GetName() << "\n";
+        if (const auto* convolution = dynamic_cast<const filters::Convolution*>(chain[i].get())) {
+            for (const std::vector<float>& row : convolution->GetKernel()) {
+                for (float weight : row) {
+                    description << " " << weight;
+                }
+                description << "\n";
+            }
+        }
+    }
+    return description.str();
+}
+
+void Touch(const std::string& path) {
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now());
+}
+}  // namespace
+
+ResultCache::ResultCache(const std::string& directory, size_t limit, std::ostream& errors)
+    : directory_(directory), limit_(limit), errors_(errors) {
+    std::filesystem::create_directories(directory_);
+    std::ifstream file(std::filesystem::path(directory_) / STATISTICS_NAME);
+    file >> statistics_.hits >> statistics_.prefix_hits >> statistics_.misses >> statistics_.evictions;
+    if (!file) {
+        statistics_ = Statistics();
+    }
+}
+
+std::string ResultCache::HashFile(const std::string& path) {
+    const reading_and_writing::MappedFile file(path);
+    return HashBytes(file.GetData(), file.GetSize());
+}
+
+std::string ResultCache::GetKey(const std::string& input_hash, const FilterChain& chain, size_t stages) {
+    return HashString(DescribeStages(input_hash, chain, stages));
+}
+
+std::string ResultCache::GetOutputKey(const std::string& input_hash, const FilterChain& chain,
+                                      const std::string& path) {
+    return HashString(DescribeStages(input_hash, chain, chain.size()) + "output " +
+                      std::filesystem::path(path).extension().string());
+}
+
+bool ResultCache::FetchOutput(const std::string& key, const std::string& path) {
+    try {
+        const std::string entry = GetEntryPath(key, "");
+        if (!std::filesystem::exists(entry)) {
+            return false;
+        }
+        std::filesystem::copy_file(entry, path, std::filesystem::copy_options::overwrite_existing);
+        Touch(entry);
+        ++statistics_.hits;
+        return true;
+    } catch (const std::exception& e) {
+        errors_ << "cache: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void ResultCache::StoreOutput(const std::string& key, const std::string& path) {
+    try {
+        const std::string temporary = GetTemporaryPath("");
+        std::filesystem::copy_file(path, temporary, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::rename(temporary, GetEntryPath(key, ""));
+    } catch (const std::exception& e) {
+        errors_ << "cache: " << e.what() << std::endl;
+    }
+}
+
+bool ResultCache::LoadImage(const std::string& key, Image& image) {
+    try {
+        const std::string entry = GetEntryPath(key, IMAGE_EXTENSION);
+        if (!std::filesystem::exists(entry)) {
+            return false;
+        }
+        image = reading_and_writing::Reader(entry).Read();
+        Touch(entry);
+        ++statistics_.prefix_hits;
+        return true;
+    } catch (const std::exception& e) {
+        errors_ << "cache: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void ResultCache::StoreImage(const std::string& key, const Image& image) {
+    try {
+        const std::string temporary = GetTemporaryPath(IMAGE_EXTENSION);
+        reading_and_writing::Writer(temporary).Write(image);
+        std::filesystem::rename(temporary, GetEntryPath(key, IMAGE_EXTENSION));
+    } catch (const std::exception& e) {
+        errors_ << "cache: " << e.what() << std::endl;
+    }
+}
+
+void ResultCache::CountMiss() {
+    ++statistics_.misses;
+}
+
+void ResultCache::Flush() {
+    try {
+        Evict();
+        const std::string temporary = GetTemporaryPath("");
+        {
+            std::ofstream file(temporary);
+            file << statistics_.hits << " " << statistics_.prefix_hits << " " << statistics_.misses << " "
+                 << statistics_.evictions << "\n";
+            if (!file) {
+                throw std::runtime_error("Can't write " + temporary);
+            }
+        }
+        std::filesystem::rename(temporary, std::filesystem::path(directory_) / STATISTICS_NAME);
+    } catch (const std::exception& e) {
+        errors_ << "cache: " << e.what() << std::endl;
+    }
+}
+
+const ResultCache::Statistics& ResultCache::GetStatistics() const {
+    return statistics_;
+}
+
+void ResultCache::PrintStatistics(std::ostream& out) const {
+    out << "cache: " << statistics_.hits << " hits, " << statistics_.prefix_hits << " prefix hits, "
+        << statistics_.misses << " misses, " << statistics_.evictions << " evictions; " << entries_
+        << " entries, " << std::fixed << std::setprecision(1) << static_cast<double>(size_) / (1 << 20) << " of "
+        << static_cast<double>(limit_) / (1 << 20) << " MB\n";
+}
+
+std::string ResultCache::GetEntryPath(const std::string& key, const std::string& extension) const {
+    return (std::filesystem::path(directory_) / (key + extension)).string();
+}
+
+std::string ResultCache::GetTemporaryPath(const std::string& extension) const {
+    return (std::filesystem::path(directory_) / ("tmp-" + std::to_string(getpid()) + extension)).string();
+}
+
+void ResultCache::Evict() {
+    // Temporary files of other processes count too; a file being written is the newest, so
+    // it is the last one to go.
+    std::vector<std::tuple<std::filesystem::file_time_type, size_t, std::filesystem::path>> entries;
+    size_ = 0;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory_)) {
+        if (entry.is_regular_file() && entry.path().filename() != STATISTICS_NAME) {
+            entries.emplace_back(entry.last_write_time(), entry.file_size(), entry.path());
+            size_ += entry.file_size();
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+    size_t evicted = 0;
+    for (; evicted < entries.size() && size_ > limit_; ++evicted) {
+        std::error_code error;
+        std::filesystem::remove(std::get<2>(entries[evicted]), error);
+        size_ -= std::get<1>(entries[evicted]);
+    }
+    entries_ = entries.size() - evicted;
+    statistics_.evictions += evicted;
+}
+}  // namespace pipeline
@@ -0,0 +1,76 @@
+#ifndef CPP_HSE_CACHE_H
+#define CPP_HSE_CACHE_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "Pipeline.h"
+#include "../Image/Image.h"
+
+namespace pipeline {
+// Results of earlier runs, kept in a directory of their own. Every entry is named after a
+// 128-bit hash of its key: the hash of the input file's bytes, header included, and the
+// names and parameters of the stages of the compiled chain that produced it. Final
+// outputs are kept encoded as they were written and copied to the output path on a hit;
+// the results after every stage are kept as QOI, so a chain that starts with the same
+// stages goes on from the longest such prefix it finds.
+//
+// The directory is kept under its size limit by removing the least recently used entries,
+// by modification time, which reading an entry updates. Hit and miss counts are kept in
+// the directory across runs. Processes can share a directory: entries are written under a
+// temporary name and renamed into place, so nobody reads a partial one, but counts can
+// lose updates made at the same time. The cache is only an optimization, so entries that
+// can't be read or written are reported to errors and otherwise treated as missing.
+class ResultCache {
+public:
+    struct Statistics {
+        size_t hits = 0;
+        size_t prefix_hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+    };
+
+    // Throws if the directory can't be created.
+    ResultCache(const std::string& directory, size_t limit, std::ostream& errors);
+
+    // Hash of the bytes of a file, in hex.
+    static std::string HashFile(const std::string& path);
+    // Key of the result of the first stages of chain for the input with the given hash.
+    static std::string GetKey(const std::string& input_hash, const FilterChain& chain, size_t stages);
+    // Key of the output of the whole chain written to a file with the extension of path,
+    // which picks its format.
+    static std::string GetOutputKey(const std::string& input_hash, const FilterChain& chain,
+                                    const std::string& path);
+
+    // Copies the output stored under key to path. Counts a hit if there is one.
+    bool FetchOutput(const std::string& key, const std::string& path);
+    void StoreOutput(const std::string& key, const std::string& path);
+    // Reads the image stored under key. Counts a prefix hit if there is one.
+    bool LoadImage(const std::string& key, Image& image);
+    void StoreImage(const std::string& key, const Image& image);
+    void CountMiss();
+
+    // Removes the least recently used entries until the directory fits in the limit, and
+    // saves the counts.
+    void Flush();
+    // Counts over all runs that used the directory, this one included.
+    const Statistics& GetStatistics() const;
+    void PrintStatistics(std::ostream& out) const;
+
+private:
+    std::string GetEntryPath(const std::string& key, const std::string& extension) const;
+    std::string GetTemporaryPath(const std::string& extension) const;
+    void Evict();
+
+    std::string directory_;
+    size_t limit_;
+    std::ostream& errors_;
+    Statistics statistics_;
+    // Size of the directory after the last eviction.
+    size_t size_ = 0;
+    size_t entries_ = 0;
+};
+}  // namespace pipeline
+
+#endif  // CPP_HSE_CACHE_H
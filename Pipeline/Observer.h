@@ -0,0 +1,19 @@
+#ifndef CPP_HSE_OBSERVER_H
+#define CPP_HSE_OBSERVER_H
+
+#include <string>
+
+namespace pipeline {
+// Gets told when the stages of a job (reading, every filter of the chain, writing) start
+// and end. Stages don't overlap and are reported from the thread that runs the job.
+// Passing no observer costs nothing beyond a null check per stage.
+class Observer {
+public:
+    virtual ~Observer() = default;
+    virtual void OnStageBegin(const std::string& stage) = 0;
+    // pixels is the number of pixels the stage took as input.
+    virtual void OnStageEnd(const std::string& stage, size_t pixels) = 0;
+};
+}  // namespace pipeline
+
+#endif  // CPP_HSE_OBSERVER_H
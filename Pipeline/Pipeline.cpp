@@ -0,0 +1,203 @@
+#include "Pipeline.h"
+
+#include <cctype>
+
+#include "Planner.h"
+
+namespace pipeline {
+namespace {
+// Halving 32 times takes any image that fits in memory down to a single pixel.
+const size_t MAX_PYRAMID_LEVELS = 32;
+// Up to about 10 TB.
+const size_t MAX_CACHE_LIMIT_DIGITS = 7;
+
+size_t ParseThreadCount(const parser::Token& token) {
+    if (token.args.size() != 1) {
+        throw std::invalid_argument("Option -j requires exactly one argument");
+    }
+    try {
+        size_t thread_count = std::stoul(token.args[0]);
+        if (thread_count > 0) {
+            return thread_count;
+        }
+    } catch (const std::logic_error&) {
+    }
+    throw std::invalid_argument("Option -j requires a positive integer thread count");
+}
+
+std::string ParseProfileFormat(const parser::Token& token) {
+    if (token.args.empty()) {
+        return "table";
+    }
+    if (token.args.size() == 1 && (token.args[0] == "table" || token.args[0] == "json")) {
+        return token.args[0];
+    }
+    throw std::invalid_argument("Option --profile takes table or json");
+}
+
+bool IsNumber(const std::string& arg) {
+    return !arg.empty() && std::all_of(arg.begin(), arg.end(), [](unsigned char c) { return std::isdigit(c); });
+}
+
+size_t ParsePyramidLevels(const parser::Token& token) {
+    if (token.args.size() != 1 || !IsNumber(token.args[0]) || token.args[0].size() > 2 ||
+        std::stoul(token.args[0]) == 0 || std::stoul(token.args[0]) > MAX_PYRAMID_LEVELS) {
+        throw std::invalid_argument("Option -pyramid requires a level count from 1 to " +
+                                    std::to_string(MAX_PYRAMID_LEVELS));
+    }
+    return std::stoul(token.args[0]);
+}
+
+void ParseCacheSettings(const parser::Token& token, Options& options) {
+    const bool has_limit = token.args.size() == 2;
+    if (token.args.empty() || token.args.size() > 2 ||
+        (has_limit && (!IsNumber(token.args[1]) || token.args[1].size() > MAX_CACHE_LIMIT_DIGITS))) {
+        throw std::invalid_argument("Option --cache takes a directory and a limit in MB");
+    }
+    options.cache_directory = token.args[0];
+    if (has_limit) {
+        options.cache_limit = std::stoul(token.args[1]) << 20;
+    }
+}
+
+void ParsePoolSettings(const parser::Token& token, Options& options) {
+    for (size_t i = 0; i < token.args.size(); ++i) {
+        const std::string& arg = token.args[i];
+        if (arg == "prefault") {
+            options.prefault = true;
+        } else if (arg == "hugepages") {
+            options.huge_pages = true;
+        } else if (i == 0 && IsNumber(arg)) {
+            options.pool_limit = std::stoul(arg) << 20;
+        } else {
+            throw std::invalid_argument("Option --pool takes a limit in MB, prefault and hugepages");
+        }
+    }
+}
+}  // namespace
+
+bool IsOption(const parser::Token& token) {
+    return token.name == "-j" || token.name == "--stream" || token.name == "--batch" || token.name == "--profile" ||
+           token.name == "--pool" || token.name == "--explain" || token.name == "--verbose" ||
+           token.name == "-pyramid" || token.name == "--cache";
+}
+
+Options ExtractOptions(std::vector<parser::Token>& tokens) {
+    Options options;
+    const size_t first_filter = std::min<size_t>(tokens.size(), 2);
+    auto options_begin = std::stable_partition(tokens.begin() + first_filter, tokens.end(),
+                                               [](const parser::Token& token) { return !IsOption(token); });
+    for (auto it = options_begin; it != tokens.end(); ++it) {
+        if (it->name == "-j") {
+            options.thread_count = ParseThreadCount(*it);
+        } else if (it->name == "--profile") {
+            options.profile = ParseProfileFormat(*it);
+        } else if (it->name == "--pool") {
+            ParsePoolSettings(*it, options);
+        } else if (it->name == "--cache") {
+            ParseCacheSettings(*it, options);
+        } else if (it->name == "-pyramid") {
+            options.pyramid_levels = ParsePyramidLevels(*it);
+        } else if (!it->args.empty()) {
+            throw std::invalid_argument("Option " + it->name + " takes no arguments");
+        } else if (it->name == "--stream") {
+            options.stream = true;
+        } else if (it->name == "--batch") {
+            options.batch = true;
+        } else if (it->name == "--explain") {
+            options.explain = true;
+        } else if (it->name == "--verbose") {
+            options.verbose = true;
+        }
+    }
+    tokens.erase(options_begin, tokens.end());
+    if (options.pyramid_levels > 0 && (options.stream || options.batch)) {
+        throw std::invalid_argument("Option -pyramid can't be combined with --stream or --batch");
+    }
+    if (!options.cache_directory.empty() && (options.stream || options.batch)) {
+        throw std::invalid_argument("Option --cache can't be combined with --stream or --batch");
+    }
+    if (!options.profile.empty() && options.batch) {
+        throw std::invalid_argument("Option --profile can't be combined with --batch");
+    }
+    return options;
+}
+
+std::string GetPyramidPath(const std::string& path, size_t level) {
+    const size_t slash = path.find_last_of('/');
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        dot = path.size();
+    }
+    return path.substr(0, dot) + "_" + std::to_string(level) + path.substr(dot);
+}
+
+FilterChain Compile(const std::vector<parser::Token>& tokens) {
+    FilterChain chain;
+    std::unique_ptr<filters::FusedPointFilter> fused;
+    for (const parser::Token& token : Plan(tokens)) {
+        std::unique_ptr<filters::Filter> filter = filters::GetFilter(token);
+        if (dynamic_cast<filters::PointFilter*>(filter.get()) != nullptr) {
+            if (!fused) {
+                fused = std::make_unique<filters::FusedPointFilter>();
+            }
+            fused->Append(std::unique_ptr<filters::PointFilter>(static_cast<filters::PointFilter*>(filter.release())));
+            continue;
+        }
+        if (fused) {
+            chain.push_back(std::move(fused));
+        }
+        chain.push_back(std::move(filter));
+    }
+    if (fused) {
+        chain.push_back(std::move(fused));
+    }
+    return chain;
+}
+
+void PushDownCrop(const FilterChain& chain, reading_and_writing::Reader& reader) {
+    if (!chain.empty() && dynamic_cast<const filters::Crop*>(chain.front().get()) != nullptr) {
+        reader.Crop(chain.front()->GetResultWidth(reader.GetWidth()), chain.front()->GetResultHeight(reader.GetHeight()));
+    }
+}
+
+reading_and_writing::PixelFormat GetOutputFormat(const FilterChain& chain) {
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if ((*it)->MakesGray()) {
+            return reading_and_writing::PixelFormat::GRAY;
+        }
+        if (!(*it)->KeepsGray()) {
+            break;
+        }
+    }
+    return reading_and_writing::PixelFormat::BGR;
+}
+
+void Run(const FilterChain& chain, Image& image, Observer* observer) {
+    Image buffer;
+    Run(chain, image, buffer, observer);
+}
+
+void Run(const FilterChain& chain, Image& image, Image& buffer, Observer* observer) {
+    RunStages(chain, 0, chain.size(), image, buffer, observer);
+}
+
+void RunStages(const FilterChain& chain, size_t begin, size_t end, Image& image, Image& buffer, Observer* observer) {
+    for (size_t i = begin; i < end; ++i) {
+        const std::unique_ptr<filters::Filter>& filter = chain[i];
+        const size_t pixels = image.GetWidth() * image.GetHeight();
+        if (observer != nullptr) {
+            observer->OnStageBegin(filter->GetName());
+        }
+        if (filter->IsInPlace()) {
+            filter->ApplyInPlace(image);
+        } else {
+            filter->ApplyTo(image, buffer);
+            std::swap(image, buffer);
+        }
+        if (observer != nullptr) {
+            observer->OnStageEnd(filter->GetName(), pixels);
+        }
+    }
+}
+}  // namespace pipeline
@@ -0,0 +1,87 @@
+#ifndef CPP_HSE_PIPELINE_H
+#define CPP_HSE_PIPELINE_H
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Observer.h"
+#include "../Filters/Filters.h"
+#include "../Image/BufferPool.h"
+#include "../Image/Image.h"
+#include "../Parser/Parser.h"
+#include "../Reading_and_writing/Reader.h"
+#include "../Reading_and_writing/Writer.h"
+
+namespace pipeline {
+using FilterChain = std::vector<std::unique_ptr<filters::Filter>>;
+
+// Options that are passed on the command line alongside the filters.
+struct Options {
+    static constexpr size_t DEFAULT_CACHE_LIMIT = size_t(1) << 30;
+
+    // -j threads; 0 keeps the default thread count.
+    size_t thread_count = 0;
+    // --stream: process the image band by band instead of loading it whole.
+    bool stream = false;
+    // --batch: the input path is a directory or a manifest of images and the output path a
+    // directory, see ListBatchJobs.
+    bool batch = false;
+    // --profile [table|json]: report the cost of every stage of a single image; empty when off.
+    std::string profile;
+    // --pool [limit MB] [prefault] [hugepages]: how much memory the image buffer pool may
+    // keep and how it allocates large buffers, see BufferPool.
+    size_t pool_limit = BufferPool::DEFAULT_RETAINED_LIMIT;
+    bool prefault = false;
+    bool huge_pages = false;
+    // --explain: print the plan for the filters instead of running them.
+    bool explain = false;
+    // --verbose: print the stages the filters run as, and how, to stderr before running them.
+    bool verbose = false;
+    // -pyramid N: also write N levels of half the size of the one before, see GetPyramidPath.
+    size_t pyramid_levels = 0;
+    // --cache directory [limit MB]: reuse results of earlier runs kept there, see
+    // ResultCache; empty when off.
+    std::string cache_directory;
+    size_t cache_limit = DEFAULT_CACHE_LIMIT;
+};
+
+// Whether the token is one of the options above rather than a filter.
+bool IsOption(const parser::Token& token);
+
+// Removes option tokens from the filter part of tokens (everything after the input and
+// output paths) and returns the parsed options.
+Options ExtractOptions(std::vector<parser::Token>& tokens);
+
+// Where level of the pyramid of an output goes: "out.bmp" has its level 1 in "out_1.bmp".
+std::string GetPyramidPath(const std::string& path, size_t level);
+
+// Builds the filters for the given filter tokens, as rewritten by Plan. Runs of consecutive
+// point-wise filters are folded into a single filters::FusedPointFilter, so they cost one
+// pass.
+FilterChain Compile(const std::vector<parser::Token>& tokens);
+
+// Lets an opened reader read only the part of the image that a crop at the start of chain
+// keeps. The crop stays in the chain, where it then has nothing left to remove.
+void PushDownCrop(const FilterChain& chain, reading_and_writing::Reader& reader);
+
+// How to store the results of chain: as 8-bit gray when they are gray whatever the input,
+// i.e. a -gs or -edge is only followed by filters that keep gray pixels gray.
+reading_and_writing::PixelFormat GetOutputFormat(const FilterChain& chain);
+
+// Applies the chain to image. In-place filters overwrite image directly, the others write
+// into a second buffer that is then swapped with image, so the chain never holds more than
+// two image buffers at a time and reuses them from stage to stage. Every filter is a stage
+// for observer, if there is one.
+void Run(const FilterChain& chain, Image& image, Observer* observer = nullptr);
+// The same with a caller-owned second buffer, for callers that run many chains.
+void Run(const FilterChain& chain, Image& image, Image& buffer, Observer* observer = nullptr);
+// The same for the stages [begin, end) of the chain only.
+void RunStages(const FilterChain& chain, size_t begin, size_t end, Image& image, Image& buffer,
+               Observer* observer = nullptr);
+}  // namespace pipeline
+
+#endif  // CPP_HSE_PIPELINE_H
@@ -0,0 +1,204 @@
+#include "Planner.h"
+
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "Pipeline.h"
+
+namespace pipeline {
+namespace {
+struct Step {
+    parser::Token token;
+    // Crops left behind a stencil filter that a copy of them was moved across. They have to
+    // stay where they are.
+    bool pinned = false;
+};
+
+size_t AddSaturating(size_t first, size_t second) {
+    return first > std::numeric_limits<size_t>::max() - second ? std::numeric_limits<size_t>::max() : first + second;
+}
+
+parser::Token MakeCrop(size_t width, size_t height) {
+    return {"-crop", {std::to_string(width), std::to_string(height)}};
+}
+
+std::pair<size_t, size_t> GetCropSize(const parser::Token& token) {
+    return {filters::ParseUnsigned(token.args[0]), filters::ParseUnsigned(token.args[1])};
+}
+
+bool IsAveraging(const parser::Token& token) {
+    return token.name == "-pix" && token.args.size() > 1;
+}
+
+bool CommutesWithCrop(const parser::Token& token) {
+    // Pixellation copies the top-left pixel of blocks that start at the top-left corner, so
+    // it doesn't matter whether pixels past the crop are there or not.
+    return token.name == "-gs" || token.name == "-neg" || (token.name == "-pix" && !IsAveraging(token));
+}
+
+size_t RoundUpSaturating(size_t value, size_t multiple) {
+    return value % multiple == 0 ? value : AddSaturating(value, multiple - value % multiple);
+}
+
+// Size of a crop that can go ahead of the filter without changing the pixels that a
+// width x height crop after it keeps, if there is one: stencil filters need their halo
+// past the edges, averaging pixellation the whole blocks at the edges. Recursive blurs
+// have no finite halo.
+std::optional<std::pair<size_t, size_t>> GetCropAhead(const parser::Token& token, size_t width, size_t height) {
+    if (IsAveraging(token)) {
+        const size_t pixel_size = filters::ParseUnsigned(token.args[0]);
+        return std::make_pair(RoundUpSaturating(width, pixel_size), RoundUpSaturating(height, pixel_size));
+    }
+    if (token.name != "-sharp" && token.name != "-edge" && token.name != "-blur" && token.name != "-boxblur" &&
+        token.name != "-conv") {
+        return std::nullopt;
+    }
+    const std::unique_ptr<filters::Filter> filter = filters::GetFilter(token);
+    const auto* blur = dynamic_cast<const filters::Blur*>(filter.get());
+    if (blur != nullptr && blur->IsRecursive()) {
+        return std::nullopt;
+    }
+    return std::make_pair(AddSaturating(width, filter->GetHalo()), AddSaturating(height, filter->GetHalo()));
+}
+
+std::string GetBlurMode(const parser::Token& token) {
+    return token.args.size() > 1 ? token.args[1] : "";
+}
+
+// Replaces the pair of steps ending at index with what they simplify to, if they do.
+bool SimplifyPair(std::vector<Step>& steps, size_t index) {
+    const parser::Token& first = steps[index - 1].token;
+    const parser::Token& second = steps[index].token;
+    if (first.name != second.name) {
+        return false;
+    }
+    auto begin = steps.begin() + static_cast<std::ptrdiff_t>(index) - 1;
+    if (first.name == "-neg") {
+        steps.erase(begin, begin + 2);
+    } else if (first.name == "-gs") {
+        steps.erase(begin);
+    } else if (first.name == "-crop") {
+        const auto [first_width, first_height] = GetCropSize(first);
+        const auto [second_width, second_height] = GetCropSize(second);
+        const bool pinned = steps[index - 1].pinned && steps[index].pinned;
+        steps[index - 1] = {MakeCrop(std::min(first_width, second_width), std::min(first_height, second_height)), pinned};
+        steps.erase(begin + 1);
+    } else if (first.name == "-blur" && GetBlurMode(first) == GetBlurMode(second)) {
+        const float first_sigma = std::stof(first.args[0]);
+        const float second_sigma = std::stof(second.args[0]);
+        std::ostringstream sigma;
+        sigma << std::sqrt(first_sigma * first_sigma + second_sigma * second_sigma);
+        parser::Token blur{"-blur", {sigma.str()}};
+        if (!GetBlurMode(first).empty()) {
+            blur.args.push_back(GetBlurMode(first));
+        }
+        steps[index - 1] = {std::move(blur)};
+        steps.erase(begin + 1);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Simplify(std::vector<Step>& steps) {
+    for (size_t i = 1; i < steps.size(); ++i) {
+        if (SimplifyPair(steps, i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Moves the first crop that can go one step ahead there.
+bool MoveCropAhead(std::vector<Step>& steps) {
+    for (size_t i = 1; i < steps.size(); ++i) {
+        if (steps[i].token.name != "-crop" || steps[i].pinned) {
+            continue;
+        }
+        const parser::Token& previous = steps[i - 1].token;
+        if (CommutesWithCrop(previous)) {
+            std::swap(steps[i - 1], steps[i]);
+            return true;
+        }
+        const auto [width, height] = GetCropSize(steps[i].token);
+        if (const auto ahead = GetCropAhead(previous, width, height)) {
+            if (*ahead == std::make_pair(width, height)) {
+                std::swap(steps[i - 1], steps[i]);
+                return true;
+            }
+            steps[i].pinned = true;
+            steps.insert(steps.begin() + static_cast<std::ptrdiff_t>(i) - 1, {MakeCrop(ahead->first, ahead->second)});
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string FormatTokens(const std::vector<parser::Token>& tokens) {
+    std::string text;
+    for (const parser::Token& token : tokens) {
+        text += text.empty() ? token.name : " " + token.name;
+        for (const std::string& arg : token.args) {
+            text += " " + arg;
+        }
+    }
+    return text.empty() ? "(no filters)" : text;
+}
+}  // namespace
+
+std::vector<parser::Token> Plan(const std::vector<parser::Token>& tokens) {
+    for (const parser::Token& token : tokens) {
+        filters::GetFilter(token);
+    }
+    std::vector<Step> steps;
+    for (const parser::Token& token : tokens) {
+        steps.push_back({token});
+    }
+    // Every move takes a crop closer to the front or merges two steps, so this ends.
+    while (Simplify(steps) || MoveCropAhead(steps)) {
+    }
+    std::vector<parser::Token> planned;
+    for (Step& step : steps) {
+        planned.push_back(std::move(step.token));
+    }
+    return planned;
+}
+
+void PrintStages(const FilterChain& chain, std::ostream& out) {
+    for (size_t i = 0; i < chain.size(); ++i) {
+        const filters::Filter& filter = *chain[i];
+        out << "  " << i + 1 << ". " << filter.GetName();
+        if (i == 0 && dynamic_cast<const filters::Crop*>(&filter) != nullptr) {
+            out << "  (done by the reader)";
+        } else if (const auto* fused = dynamic_cast<const filters::FusedPointFilter*>(&filter);
+                   fused != nullptr && fused->GetSize() > 1) {
+            out << "  (one fused pass, in place)";
+        } else if (filter.IsInPlace()) {
+            out << "  (in place)";
+        } else if (const auto* convolution = dynamic_cast<const filters::Convolution*>(&filter);
+                   convolution != nullptr && convolution->IsSeparable()) {
+            out << "  (separable: " << convolution->GetKernelWidth() << "-tap rows and "
+                << convolution->GetKernelHeight() << "-tap columns, halo " << filter.GetHalo() << ")";
+        } else if (convolution != nullptr) {
+            out << "  (2-D: " << convolution->GetKernelWidth() << "x" << convolution->GetKernelHeight()
+                << " taps in column strips, halo " << filter.GetHalo() << ")";
+        } else if (dynamic_cast<const filters::Resize*>(&filter) != nullptr) {
+            out << "  (rows, then columns)";
+        } else {
+            out << "  (halo " << filter.GetHalo() << ")";
+        }
+        out << "\n";
+    }
+}
+
+void Explain(const std::vector<parser::Token>& tokens, std::ostream& out) {
+    out << "requested: " << FormatTokens(tokens) << "\n";
+    out << "planned:   " << FormatTokens(Plan(tokens)) << "\n";
+    out << "stages:\n";
+    PrintStages(Compile(tokens), out);
+}
+}  // namespace pipeline
@@ -0,0 +1,31 @@
+#ifndef CPP_HSE_PLANNER_H
+#define CPP_HSE_PLANNER_H
+
+#include <ostream>
+#include <vector>
+
+#include "../Parser/Parser.h"
+#include "Pipeline.h"
+
+namespace pipeline {
+// Rewrites filter tokens into a chain with the same result that costs less. Every token is
+// validated first, so bad arguments fail before any input is read. The rewrites are:
+// - a crop moves ahead of point filters and pixellation, which commute with it;
+// - a crop moves ahead of a stencil filter as a crop enlarged by the stencil's halo, and
+//   stays behind it as it was, so the pixels that are kept come out the same. Recursive
+//   blurs have no finite halo and stop it. Averaging pixellation takes a crop enlarged to
+//   whole blocks the same way;
+// - consecutive crops merge, -neg -neg cancels out and repeated -gs collapse to one;
+// - consecutive blurs of the same mode merge into one with sigma = sqrt(s1^2 + s2^2),
+//   which is what the two compose to before rounding.
+// All but the last rewrite give exactly the same pixels.
+std::vector<parser::Token> Plan(const std::vector<parser::Token>& tokens);
+
+// Prints the stages of a compiled chain one per line, with how each of them runs.
+void PrintStages(const FilterChain& chain, std::ostream& out);
+
+// Prints the requested chain, the planned one and the stages it compiles to, for --explain.
+void Explain(const std::vector<parser::Token>& tokens, std::ostream& out);
+}  // namespace pipeline
+
+#endif  // CPP_HSE_PLANNER_H
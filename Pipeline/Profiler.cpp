@@ -0,0 +1,100 @@
+#include "Profiler.h"
+
+#include <iomanip>
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include "../Image/BufferPool.h"
+#include "../Server/Json.h"
+
+namespace pipeline {
+namespace {
+// ru_maxrss is in kilobytes on Linux.
+const size_t RSS_UNIT = 1024;
+
+double GetPixelsPerSecond(const Profiler::Stage& stage) {
+    return stage.wall_seconds > 0 ? static_cast<double>(stage.pixels) / stage.wall_seconds : 0;
+}
+}  // namespace
+
+void Profiler::OnStageBegin(const std::string&) {
+    begin_ = TakeSnapshot();
+}
+
+void Profiler::OnStageEnd(const std::string& stage, size_t pixels) {
+    const Snapshot end = TakeSnapshot();
+    stages_.push_back({stage, pixels, std::chrono::duration<double>(end.wall - begin_.wall).count(),
+                       end.cpu_seconds - begin_.cpu_seconds, end.allocated_bytes - begin_.allocated_bytes,
+                       end.reused_bytes - begin_.reused_bytes, end.peak_rss - begin_.peak_rss});
+}
+
+const std::vector<Profiler::Stage>& Profiler::GetStages() const {
+    return stages_;
+}
+
+void Profiler::PrintTable(std::ostream& out) const {
+    out << std::left << std::setw(24) << "stage" << std::right << std::setw(12) << "wall ms" << std::setw(12)
+        << "cpu ms" << std::setw(14) << "alloc MB" << std::setw(14) << "reused MB" << std::setw(14) << "peak rss MB"
+        << std::setw(14) << "Mpixels/s"
+        << "\n";
+    Stage total{"total"};
+    out << std::fixed << std::setprecision(3);
+    auto print = [&out](const Stage& stage, bool throughput) {
+        out << std::left << std::setw(24) << stage.name << std::right << std::setw(12) << stage.wall_seconds * 1e3
+            << std::setw(12) << stage.cpu_seconds * 1e3 << std::setw(14) << static_cast<double>(stage.allocated_bytes) / 1e6
+            << std::setw(14) << static_cast<double>(stage.reused_bytes) / 1e6 << std::setw(14)
+            << static_cast<double>(stage.peak_rss_delta) / 1e6 << std::setw(14);
+        if (throughput) {
+            out << GetPixelsPerSecond(stage) / 1e6;
+        } else {
+            out << "";
+        }
+        out << "\n";
+    };
+    for (const Stage& stage : stages_) {
+        print(stage, true);
+        total.wall_seconds += stage.wall_seconds;
+        total.cpu_seconds += stage.cpu_seconds;
+        total.allocated_bytes += stage.allocated_bytes;
+        total.reused_bytes += stage.reused_bytes;
+        total.peak_rss_delta += stage.peak_rss_delta;
+    }
+    print(total, false);
+    const BufferPool::Stats pool = GetBufferPool().GetStats();
+    out << "buffer pool: " << pool.hits << " hits, " << pool.misses << " misses, " << pool.evictions
+        << " evictions, " << static_cast<double>(pool.held_bytes) / 1e6 << " MB held in " << pool.held_buffers
+        << " buffers\n";
+}
+
+void Profiler::PrintJson(std::ostream& out) const {
+    out << "{\"stages\": [";
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        const Stage& stage = stages_[i];
+        out << (i == 0 ? "" : ", ") << "{\"name\": " << server::QuoteJson(stage.name) << ", \"pixels\": " << stage.pixels
+            << ", \"wall_ms\": " << stage.wall_seconds * 1e3 << ", \"cpu_ms\": " << stage.cpu_seconds * 1e3
+            << ", \"allocated_bytes\": " << stage.allocated_bytes
+            << ", \"reused_bytes\": " << stage.reused_bytes << ", \"peak_rss_delta_bytes\": " << stage.peak_rss_delta
+            << ", \"pixels_per_s\": " << GetPixelsPerSecond(stage) << "}";
+    }
+    const BufferPool::Stats pool = GetBufferPool().GetStats();
+    out << "], \"pool\": {\"hits\": " << pool.hits << ", \"misses\": " << pool.misses
+        << ", \"evictions\": " << pool.evictions << ", \"held_bytes\": " << pool.held_bytes
+        << ", \"held_buffers\": " << pool.held_buffers << "}}\n";
+}
+
+Profiler::Snapshot Profiler::TakeSnapshot() {
+    Snapshot snapshot;
+    snapshot.wall = std::chrono::steady_clock::now();
+    timespec cpu = {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    snapshot.cpu_seconds = static_cast<double>(cpu.tv_sec) + static_cast<double>(cpu.tv_nsec) * 1e-9;
+    const BufferPool::Stats pool = GetBufferPool().GetStats();
+    snapshot.allocated_bytes = pool.allocated_bytes;
+    snapshot.reused_bytes = pool.reused_bytes;
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    snapshot.peak_rss = static_cast<size_t>(usage.ru_maxrss) * RSS_UNIT;
+    return snapshot;
+}
+}  // namespace pipeline
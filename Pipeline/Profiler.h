@@ -0,0 +1,50 @@
+#ifndef CPP_HSE_PROFILER_H
+#define CPP_HSE_PROFILER_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Observer.h"
+
+namespace pipeline {
+// Observer that measures every stage: wall time, CPU time of the whole process (all
+// threads), bytes of image buffers newly allocated and reused from the BufferPool, growth
+// of the peak resident set size and throughput in pixels per second.
+class Profiler : public Observer {
+public:
+    struct Stage {
+        std::string name;
+        size_t pixels = 0;
+        double wall_seconds = 0;
+        double cpu_seconds = 0;
+        size_t allocated_bytes = 0;
+        size_t reused_bytes = 0;
+        size_t peak_rss_delta = 0;
+    };
+
+    void OnStageBegin(const std::string& stage) override;
+    void OnStageEnd(const std::string& stage, size_t pixels) override;
+
+    const std::vector<Stage>& GetStages() const;
+    void PrintTable(std::ostream& out) const;
+    void PrintJson(std::ostream& out) const;
+
+private:
+    struct Snapshot {
+        std::chrono::steady_clock::time_point wall;
+        double cpu_seconds = 0;
+        size_t allocated_bytes = 0;
+        size_t reused_bytes = 0;
+        size_t peak_rss = 0;
+    };
+
+    static Snapshot TakeSnapshot();
+
+    Snapshot begin_;
+    std::vector<Stage> stages_;
+};
+}  // namespace pipeline
+
+#endif  // CPP_HSE_PROFILER_H
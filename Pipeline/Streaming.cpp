@@ -0,0 +1,195 @@
+#include "Streaming.h"
+
+#include <sys/stat.h>
+
+namespace pipeline {
+namespace {
+// A band holds about this many bytes, unless the halos of the chain need more rows.
+const size_t STREAM_BAND_SIZE = 4 << 20;
+// Bands are at least this many times as high as the largest halo, so that filtering the
+// halo rows again for every band costs a small fraction of the work.
+const size_t STREAM_BAND_HALO_FACTOR = 8;
+
+// A stage of the streamed chain that produces rows of its result on request. Every call
+// to Read continues where the previous one ended, starting from row 0.
+class RowSource {
+public:
+    RowSource(size_t width, size_t height) : width_(width), height_(height) {
+    }
+    virtual ~RowSource() = default;
+
+    size_t GetWidth() const {
+        return width_;
+    }
+    size_t GetHeight() const {
+        return height_;
+    }
+    // Fills rows with the rows [begin, end) of the result.
+    virtual void Read(size_t begin, size_t end, Image& rows) = 0;
+
+private:
+    size_t width_;
+    size_t height_;
+};
+
+class ReaderSource : public RowSource {
+public:
+    explicit ReaderSource(const reading_and_writing::Reader& reader)
+        : RowSource(reader.GetWidth(), reader.GetHeight()), reader_(reader) {
+    }
+    void Read(size_t begin, size_t end, Image& rows) override {
+        rows.Reshape(GetWidth(), end - begin);
+        reader_.ReadRows(begin, rows);
+    }
+
+private:
+    const reading_and_writing::Reader& reader_;
+};
+
+// Filters whose result rows depend on the same input rows only (point filters, crop) run
+// on the band in place.
+class RowLocalStage : public RowSource {
+public:
+    RowLocalStage(const filters::Filter& filter, std::unique_ptr<RowSource> input)
+        : RowSource(filter.GetResultWidth(input->GetWidth()), filter.GetResultHeight(input->GetHeight())),
+          filter_(filter),
+          input_(std::move(input)) {
+    }
+    void Read(size_t begin, size_t end, Image& rows) override {
+        input_->Read(begin, end, rows);
+        filter_.ApplyInPlace(rows);
+    }
+
+private:
+    const filters::Filter& filter_;
+    std::unique_ptr<RowSource> input_;
+};
+
+// Stencil filters run on a window of input rows around the requested ones. The window
+// slides down the image: rows that later windows still need are kept, the rest dropped.
+class WindowStage : public RowSource {
+public:
+    WindowStage(const filters::Filter& filter, std::unique_ptr<RowSource> input)
+        : RowSource(input->GetWidth(), input->GetHeight()),
+          filter_(filter),
+          input_(std::move(input)),
+          window_(GetWidth(), 0) {
+    }
+    void Read(size_t begin, size_t end, Image& rows) override {
+        // Rows closer than the halo to the window's edges are affected by the edges, unless
+        // those are the image's own. The window starts on a multiple of the alignment, like
+        // bands of the whole image do.
+        const size_t halo = filter_.GetHalo();
+        const size_t alignment = std::max<size_t>(1, filter_.GetRowAlignment());
+        const size_t window_begin = (begin - std::min(begin, halo)) / alignment * alignment;
+        const size_t window_end = std::min(GetHeight(), end + halo);
+
+        window_.DropRows(window_begin - window_begin_);
+        window_begin_ = window_begin;
+        const size_t window_rows = window_.GetHeight();
+        if (window_begin_ + window_rows < window_end) {
+            input_->Read(window_begin_ + window_rows, window_end, input_rows_);
+            window_.ResizeRows(window_end - window_begin_);
+            for (size_t i = 0; i < input_rows_.GetHeight(); ++i) {
+                std::copy(input_rows_.GetRow(i), input_rows_.GetRow(i) + GetWidth(), window_.GetRow(window_rows + i));
+            }
+        }
+
+        filter_.ApplyTo(window_, result_);
+        rows.Reshape(GetWidth(), end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            const Color* row = result_.GetRow(i - window_begin_);
+            std::copy(row, row + GetWidth(), rows.GetRow(i - begin));
+        }
+    }
+
+private:
+    const filters::Filter& filter_;
+    std::unique_ptr<RowSource> input_;
+    Image window_;
+    size_t window_begin_ = 0;
+    Image input_rows_;
+    Image result_;
+};
+
+// Resizing maps result rows to a window of input rows that moves down the image at its
+// own pace, faster or slower than the result rows do.
+class ResizeStage : public RowSource {
+public:
+    ResizeStage(const filters::Resize& resize, std::unique_ptr<RowSource> input)
+        : RowSource(resize.GetResultWidth(input->GetWidth()), resize.GetResultHeight(input->GetHeight())),
+          resize_(resize),
+          input_(std::move(input)),
+          window_(input_->GetWidth(), 0) {
+    }
+    void Read(size_t begin, size_t end, Image& rows) override {
+        // The input is read on from where it stopped, even when the new window starts past
+        // it, and the rows before the window dropped afterwards.
+        const auto [window_begin, window_end] = resize_.GetSourceRows(input_->GetHeight(), begin, end);
+        const size_t window_rows = window_.GetHeight();
+        if (window_begin_ + window_rows < window_end) {
+            input_->Read(window_begin_ + window_rows, window_end, input_rows_);
+            window_.ResizeRows(window_end - window_begin_);
+            for (size_t i = 0; i < input_rows_.GetHeight(); ++i) {
+                std::copy(input_rows_.GetRow(i), input_rows_.GetRow(i) + input_->GetWidth(),
+                          window_.GetRow(window_rows + i));
+            }
+        }
+        window_.DropRows(window_begin - window_begin_);
+        window_begin_ = window_begin;
+        resize_.ApplyToRows(window_, window_begin_, input_->GetHeight(), begin, end, rows);
+    }
+
+private:
+    const filters::Resize& resize_;
+    std::unique_ptr<RowSource> input_;
+    Image window_;
+    size_t window_begin_ = 0;
+    Image input_rows_;
+};
+
+// Whether both paths name the same file, through links or not. Nonexistent files are
+// different from everything.
+bool IsSameFile(const std::string& first, const std::string& second) {
+    struct stat first_status = {};
+    struct stat second_status = {};
+    return stat(first.c_str(), &first_status) == 0 && stat(second.c_str(), &second_status) == 0 &&
+           first_status.st_dev == second_status.st_dev && first_status.st_ino == second_status.st_ino;
+}
+}  // namespace
+
+void RunStreaming(const FilterChain& chain, reading_and_writing::Reader& reader, reading_and_writing::Writer& writer) {
+    std::unique_ptr<RowSource> source = std::make_unique<ReaderSource>(reader);
+    size_t max_halo = 0;
+    for (const std::unique_ptr<filters::Filter>& filter : chain) {
+        if (filter->IsInPlace() && filter->GetHalo() == 0 && filter->GetRowAlignment() == 1) {
+            source = std::make_unique<RowLocalStage>(*filter, std::move(source));
+        } else if (const auto* resize = dynamic_cast<const filters::Resize*>(filter.get()); resize != nullptr) {
+            source = std::make_unique<ResizeStage>(*resize, std::move(source));
+        } else {
+            source = std::make_unique<WindowStage>(*filter, std::move(source));
+            max_halo = std::max(max_halo, std::max(filter->GetHalo(), filter->GetRowAlignment()));
+        }
+    }
+
+    const size_t width = source->GetWidth();
+    const size_t height = source->GetHeight();
+    // Truncating the input while it is mapped would lose the rows not read yet.
+    if (IsSameFile(reader.GetPath(), writer.GetPath())) {
+        writer.ReplaceOnClose();
+    }
+    writer.Open(width, height);
+    if (!writer.CanWriteTopDown()) {
+        throw std::invalid_argument("Streaming a BMP needs an output file that can be written in any order");
+    }
+    const size_t row_size = std::max<size_t>(1, reader.GetWidth() * sizeof(Color));
+    const size_t band_rows = std::max({STREAM_BAND_SIZE / row_size, STREAM_BAND_HALO_FACTOR * max_halo, size_t{1}});
+    Image rows;
+    for (size_t begin = 0; begin < height; begin += band_rows) {
+        const size_t end = std::min(height, begin + band_rows);
+        source->Read(begin, end, rows);
+        writer.WriteRows(begin, rows);
+    }
+    writer.Close();
+}
+}  // namespace pipeline
@@ -0,0 +1,21 @@
+#ifndef CPP_HSE_STREAMING_H
+#define CPP_HSE_STREAMING_H
+
+#include "Pipeline.h"
+#include "../Reading_and_writing/Reader.h"
+#include "../Reading_and_writing/Writer.h"
+
+namespace pipeline {
+// Runs the chain over the image in reader band by band and writes the result into writer,
+// for images that don't fit in memory. Every filter keeps just the rows its halo needs
+// from the previous band, so memory grows with the width and the total halo of the chain,
+// not with the height of the image; a resize keeps the input rows its band is resampled
+// from. The output must be seekable.
+//
+// The result is the same as Run gives, except for recursive blurs: those depend on the
+// whole column in principle and see 4 sigma of rows around a band here, which changes
+// pixels by at most a level, about 0.2 levels RMS for sigma up to 40.
+void RunStreaming(const FilterChain& chain, reading_and_writing::Reader& reader, reading_and_writing::Writer& writer);
+}  // namespace pipeline
+
+#endif  // CPP_HSE_STREAMING_H
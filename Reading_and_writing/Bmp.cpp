@@ -0,0 +1,243 @@
+#include "Bmp.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "../Threads/Scheduler.h"
+
+namespace {
+size_t BytesToRead(const unsigned char* bytes) {
+    size_t number = *bytes;
+    for (size_t i = 0; i < image::utils::SHIFT_BITS.size(); ++i) {
+        number += static_cast<size_t>(*(bytes + i + 1)) << image::utils::SHIFT_BITS[i];
+    }
+    return number;
+}
+
+template <typename T>
+void WriteBytes(T number, unsigned char* bytes) {
+    *bytes = number;
+    for (size_t i = 0; i < image::utils::SHIFT_BITS.size(); ++i) {
+        *(bytes + i + 1) = number >> image::utils::SHIFT_BITS[i];
+    }
+}
+}  // namespace
+
+size_t reading_and_writing::GetPaddedRowSize(size_t width, size_t bits_per_pixel) {
+    const size_t row_size = width * bits_per_pixel / CHAR_BIT;
+    return (row_size + image::utils::PADDING_BYTES - 1) / image::utils::PADDING_BYTES * image::utils::PADDING_BYTES;
+}
+
+reading_and_writing::BmpDecoder::BmpDecoder(const std::string& path, const MappedFile& file)
+    : path_(path), file_(file) {
+    ParseHeaders();
+}
+
+size_t reading_and_writing::BmpDecoder::GetWidth() const {
+    return width_;
+}
+
+size_t reading_and_writing::BmpDecoder::GetHeight() const {
+    return height_;
+}
+
+void reading_and_writing::BmpDecoder::ReadRows(size_t first_row, Image& rows) {
+    const size_t count = rows.GetHeight();
+    if (count == 0) {
+        return;
+    }
+    // The requested rows are contiguous in the file, in reverse order unless it is top-down.
+    // Each one is decoded straight into its final place.
+    const size_t first_file_row = std::min(GetFileRow(first_row), GetFileRow(first_row + count - 1));
+    const size_t begin = pixel_array_offset_ + first_file_row * padded_row_size_;
+    const size_t size = count * padded_row_size_;
+    const size_t row_size = rows.GetWidth() * bits_per_pixel_ / CHAR_BIT;
+    // Reading ahead whole rows only pays off when most of every row is needed.
+    if (row_size * 2 >= padded_row_size_) {
+        file_.WillNeed(begin, size);
+    }
+    const unsigned char* pixels = file_.GetData() + pixel_array_offset_;
+    threads::ParallelForRows(count, 1, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            DecodeRow(pixels + GetFileRow(first_row + i) * padded_row_size_, rows.GetRow(i), rows.GetWidth());
+        }
+    });
+    file_.DontNeed(begin, size);
+}
+
+size_t reading_and_writing::BmpDecoder::GetFileRow(size_t row) const {
+    return top_down_ ? row : height_ - 1 - row;
+}
+
+void reading_and_writing::BmpDecoder::DecodeRow(const unsigned char* bytes, Color* row, size_t width) const {
+    if (bits_per_pixel_ == image::utils::BITS_PER_PIXEL) {
+        std::memcpy(row, bytes, width * sizeof(Color));
+    } else if (bits_per_pixel_ == image::utils::BGRA_BITS_PER_PIXEL) {
+        for (size_t j = 0; j < width; ++j) {
+            std::memcpy(row + j, bytes + j * (image::utils::BGRA_BITS_PER_PIXEL / CHAR_BIT), sizeof(Color));
+        }
+    } else {
+        for (size_t j = 0; j < width; ++j) {
+            row[j] = palette_[bytes[j]];
+        }
+    }
+}
+
+void reading_and_writing::BmpDecoder::ParseHeaders() {
+    const unsigned char* data = file_.GetData();
+    const size_t size = file_.GetSize();
+    if (size < image::utils::BMP_HEADER_SIZE || data[0] != image::utils::HEADER_SIGNATURE[0] ||
+        data[1] != image::utils::HEADER_SIGNATURE[1]) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is not a BMP file"));
+    }
+    if (size < image::utils::BMP_HEADER_SIZE + image::utils::DIB_HEADER_SIZE) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is truncated"));
+    }
+    const unsigned char* dib_header = data + image::utils::BMP_HEADER_SIZE;
+    const size_t dib_header_size = BytesToRead(dib_header + image::utils::INFORMATION_HEADER_SIZE_POSITION);
+    if (dib_header_size < image::utils::DIB_HEADER_SIZE) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" has an unsupported BMP header"));
+    }
+    pixel_array_offset_ = BytesToRead(data + image::utils::PIXEL_ARRAY_OFFSET);
+    // Both are signed; a negative height marks a top-down file.
+    const auto width = static_cast<int32_t>(BytesToRead(dib_header + image::utils::HEADER_WIDTH_OFFSET));
+    const auto height = static_cast<int32_t>(BytesToRead(dib_header + image::utils::HEADER_HEIGHT_OFFSET));
+    if (width < 0 || height == std::numeric_limits<int32_t>::min()) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" has invalid dimensions"));
+    }
+    top_down_ = height < 0;
+    width_ = static_cast<size_t>(width);
+    height_ = static_cast<size_t>(top_down_ ? -height : height);
+    ParsePixelFormat(dib_header_size);
+
+    padded_row_size_ = GetPaddedRowSize(width_, bits_per_pixel_);
+    if (pixel_array_offset_ > size ||
+        (padded_row_size_ != 0 && height_ > (size - pixel_array_offset_) / padded_row_size_)) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is truncated"));
+    }
+}
+
+void reading_and_writing::BmpDecoder::ParsePixelFormat(size_t dib_header_size) {
+    const unsigned char* data = file_.GetData();
+    const size_t size = file_.GetSize();
+    const unsigned char* dib_header = data + image::utils::BMP_HEADER_SIZE;
+    bits_per_pixel_ =
+        dib_header[image::utils::BITS_PER_PIXEL_POSITION] | dib_header[image::utils::BITS_PER_PIXEL_POSITION + 1] << 8;
+    const size_t compression = BytesToRead(dib_header + image::utils::COMPRESSION_POSITION);
+    if (bits_per_pixel_ != image::utils::BITS_PER_PIXEL && bits_per_pixel_ != image::utils::BGRA_BITS_PER_PIXEL &&
+        bits_per_pixel_ != image::utils::GRAY_BITS_PER_PIXEL) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is not a 24-, 32- or 8-bit BMP file"));
+    }
+    if (compression == image::utils::BITFIELDS && bits_per_pixel_ == image::utils::BGRA_BITS_PER_PIXEL) {
+        // Only the usual layout, blue in the lowest byte, can be copied as it is.
+        const size_t mask_size = sizeof(uint32_t);
+        const unsigned char* masks = dib_header + image::utils::CHANNEL_MASKS_POSITION;
+        if (size < image::utils::BMP_HEADER_SIZE + image::utils::CHANNEL_MASKS_POSITION + 3 * mask_size ||
+            BytesToRead(masks) != image::utils::RED_MASK || BytesToRead(masks + mask_size) != image::utils::GREEN_MASK ||
+            BytesToRead(masks + 2 * mask_size) != image::utils::BLUE_MASK) {
+            throw std::invalid_argument(std::string("File ") + path_ + std::string(" has unsupported channel masks"));
+        }
+    } else if (compression != image::utils::UNCOMPRESSED) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is compressed"));
+    }
+    if (bits_per_pixel_ != image::utils::GRAY_BITS_PER_PIXEL) {
+        return;
+    }
+    // Indices past the palette are black, like most readers show them.
+    size_t colors = BytesToRead(dib_header + image::utils::COLORS_USED_POSITION);
+    colors = colors == 0 ? image::utils::PALETTE_SIZE : std::min<size_t>(colors, image::utils::PALETTE_SIZE);
+    const size_t palette_offset = image::utils::BMP_HEADER_SIZE + dib_header_size;
+    if (palette_offset > size || colors > (size - palette_offset) / image::utils::PALETTE_ENTRY_SIZE) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is truncated"));
+    }
+    palette_.fill(Color());
+    for (size_t i = 0; i < colors; ++i) {
+        std::memcpy(&palette_[i], data + palette_offset + i * image::utils::PALETTE_ENTRY_SIZE, sizeof(Color));
+    }
+}
+
+reading_and_writing::BmpEncoder::BmpEncoder(PixelFormat format, size_t width, size_t height)
+    : format_(format), width_(width), height_(height) {
+    const size_t palette_size = image::utils::PALETTE_SIZE * image::utils::PALETTE_ENTRY_SIZE;
+    // The palette outweighs the savings of gray pixels on tiny images.
+    if (format_ == PixelFormat::GRAY &&
+        palette_size + height * GetPaddedRowSize(width, image::utils::GRAY_BITS_PER_PIXEL) >=
+            height * GetPaddedRowSize(width, image::utils::BITS_PER_PIXEL)) {
+        format_ = PixelFormat::BGR;
+    }
+    headers_size_ = image::utils::BMP_HEADER_SIZE + image::utils::DIB_HEADER_SIZE;
+    if (format_ == PixelFormat::GRAY) {
+        headers_size_ += palette_size;
+    }
+    padded_row_size_ = GetPaddedRowSize(width, GetBitsPerPixel());
+}
+
+std::vector<unsigned char> reading_and_writing::BmpEncoder::GetHeader() const {
+    std::vector<unsigned char> headers(headers_size_, 0);
+    WriteBMPHeader(headers.data(), headers_size_ + height_ * padded_row_size_);
+    WriteDIBHeader(headers.data() + image::utils::BMP_HEADER_SIZE);
+    if (format_ == PixelFormat::GRAY) {
+        WritePalette(headers.data() + image::utils::BMP_HEADER_SIZE + image::utils::DIB_HEADER_SIZE);
+    }
+    return headers;
+}
+
+size_t reading_and_writing::BmpEncoder::GetRowSize() const {
+    return padded_row_size_;
+}
+
+bool reading_and_writing::BmpEncoder::IsBottomUp() const {
+    return true;
+}
+
+void reading_and_writing::BmpEncoder::EncodeRows(const Image& image, size_t begin, size_t end, const Color&,
+                                                 std::vector<unsigned char>& output) const {
+    const size_t row_size = image.GetWidth() * GetBitsPerPixel() / CHAR_BIT;
+    output.resize((end - begin) * padded_row_size_);
+    unsigned char* bytes = output.data();
+    for (size_t i = end; i-- > begin;) {
+        const Color* row = image.GetRow(i);
+        if (format_ == PixelFormat::GRAY) {
+            for (size_t j = 0; j < image.GetWidth(); ++j) {
+                bytes[j] = row[j].blue;
+            }
+        } else {
+            std::memcpy(bytes, row, row_size);
+        }
+        std::fill(bytes + row_size, bytes + padded_row_size_, 0);
+        bytes += padded_row_size_;
+    }
+}
+
+void reading_and_writing::BmpEncoder::WriteBMPHeader(unsigned char* bmp_header, size_t file_size) const {
+    bmp_header[image::utils::FILE_FORMAT_FIRST_POSITION] = image::utils::HEADER_SIGNATURE[0];
+    bmp_header[image::utils::FILE_FORMAT_SECOND_POSITION] = image::utils::HEADER_SIGNATURE[1];
+    WriteBytes(file_size, bmp_header + image::utils::HEADER_FILE_SIZE_OFFSET);
+    WriteBytes(headers_size_, bmp_header + image::utils::PIXEL_ARRAY_OFFSET);
+}
+
+void reading_and_writing::BmpEncoder::WriteDIBHeader(unsigned char* dib_header) const {
+    dib_header[image::utils::INFORMATION_HEADER_SIZE_POSITION] = image::utils::DIB_HEADER_SIZE;
+    WriteBytes(width_, dib_header + image::utils::HEADER_WIDTH_OFFSET);
+    WriteBytes(height_, dib_header + image::utils::HEADER_HEIGHT_OFFSET);
+    dib_header[image::utils::COLOR_PLANES_POSITION] = image::utils::COLOR_PLANES;
+    dib_header[image::utils::BITS_PER_PIXEL_POSITION] = GetBitsPerPixel();
+    if (format_ == PixelFormat::GRAY) {
+        WriteBytes(image::utils::PALETTE_SIZE, dib_header + image::utils::COLORS_USED_POSITION);
+    }
+}
+
+void reading_and_writing::BmpEncoder::WritePalette(unsigned char* palette) const {
+    for (size_t i = 0; i < image::utils::PALETTE_SIZE; ++i) {
+        std::fill(palette, palette + sizeof(Color), static_cast<unsigned char>(i));
+        palette[sizeof(Color)] = 0;
+        palette += image::utils::PALETTE_ENTRY_SIZE;
+    }
+}
+
+size_t reading_and_writing::BmpEncoder::GetBitsPerPixel() const {
+    return format_ == PixelFormat::GRAY ? image::utils::GRAY_BITS_PER_PIXEL : image::utils::BITS_PER_PIXEL;
+}
@@ -0,0 +1,69 @@
+#ifndef CPP_HSE_BMP_H
+#define CPP_HSE_BMP_H
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "Codec.h"
+#include "MappedFile.h"
+#include "Utils.h"
+
+namespace reading_and_writing {
+// Uncompressed BMP files with 24-bit BGR, 32-bit BGRA (alpha is dropped) or 8-bit
+// palettized pixels, stored bottom-up or top-down.
+class BmpDecoder : public Decoder {
+public:
+    BmpDecoder(const std::string& path, const MappedFile& file);
+    size_t GetWidth() const override;
+    size_t GetHeight() const override;
+    void ReadRows(size_t first_row, Image& rows) override;
+
+private:
+    void ParseHeaders();
+    void ParsePixelFormat(size_t dib_header_size);
+    // Index of the file row, counted from the start of the pixel array, that holds image row.
+    size_t GetFileRow(size_t row) const;
+    void DecodeRow(const unsigned char* bytes, Color* row, size_t width) const;
+
+    std::string path_;
+    const MappedFile& file_;
+    size_t width_ = 0;
+    size_t height_ = 0;
+    bool top_down_ = false;
+    size_t bits_per_pixel_ = 0;
+    std::array<Color, image::utils::PALETTE_SIZE> palette_;
+    size_t pixel_array_offset_ = 0;
+    size_t padded_row_size_ = 0;
+};
+
+// Writes 24-bit bottom-up BMP files, or 8-bit ones with a gray palette for gray images
+// when that makes the file smaller.
+class BmpEncoder : public Encoder {
+public:
+    BmpEncoder(PixelFormat format, size_t width, size_t height);
+    std::vector<unsigned char> GetHeader() const override;
+    size_t GetRowSize() const override;
+    bool IsBottomUp() const override;
+    void EncodeRows(const Image& image, size_t begin, size_t end, const Color& previous,
+                    std::vector<unsigned char>& output) const override;
+
+private:
+    void WriteDIBHeader(unsigned char* dib_header) const;
+    void WriteBMPHeader(unsigned char* bmp_header, size_t file_size) const;
+    void WritePalette(unsigned char* palette) const;
+    size_t GetBitsPerPixel() const;
+
+    PixelFormat format_;
+    size_t width_;
+    size_t height_;
+    // Headers and palette.
+    size_t headers_size_ = 0;
+    size_t padded_row_size_ = 0;
+};
+
+// Size of a row of width pixels in a BMP file, padded to a multiple of 4 bytes.
+size_t GetPaddedRowSize(size_t width, size_t bits_per_pixel);
+}  // namespace reading_and_writing
+
+#endif  // CPP_HSE_BMP_H
@@ -0,0 +1,65 @@
+#include "Codec.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#include "Bmp.h"
+#include "Pnm.h"
+#include "Qoi.h"
+#include "Utils.h"
+
+namespace {
+bool StartsWith(const reading_and_writing::MappedFile& file, const std::vector<char>& signature) {
+    return file.GetSize() >= signature.size() && std::memcmp(file.GetData(), signature.data(), signature.size()) == 0;
+}
+
+std::string GetExtension(const std::string& path) {
+    const size_t dot = path.find_last_of('.');
+    const size_t slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return "";
+    }
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char character) { return std::tolower(character); });
+    return extension;
+}
+}  // namespace
+
+std::vector<unsigned char> reading_and_writing::Encoder::GetTrailer() const {
+    return {};
+}
+
+bool reading_and_writing::Encoder::IsBottomUp() const {
+    return false;
+}
+
+std::unique_ptr<reading_and_writing::Decoder> reading_and_writing::CreateDecoder(const std::string& path,
+                                                                                 const MappedFile& file) {
+    if (StartsWith(file, image::utils::HEADER_SIGNATURE)) {
+        return std::make_unique<BmpDecoder>(path, file);
+    }
+    if (StartsWith(file, image::utils::PPM_SIGNATURE) || StartsWith(file, image::utils::PGM_SIGNATURE)) {
+        return std::make_unique<PnmDecoder>(path, file);
+    }
+    if (StartsWith(file, image::utils::QOI_SIGNATURE)) {
+        return std::make_unique<QoiDecoder>(path, file);
+    }
+    throw std::invalid_argument(std::string("File ") + path + std::string(" is not a BMP, PPM, PGM or QOI file"));
+}
+
+std::unique_ptr<reading_and_writing::Encoder> reading_and_writing::CreateEncoder(const std::string& path,
+                                                                                 PixelFormat format, size_t width,
+                                                                                 size_t height) {
+    const std::string extension = GetExtension(path);
+    if (extension == "qoi") {
+        return std::make_unique<QoiEncoder>(width, height);
+    }
+    if (extension == "ppm" || extension == "pgm" || extension == "pnm") {
+        const bool gray = extension == "pgm" || (extension == "pnm" && format == PixelFormat::GRAY);
+        return std::make_unique<PnmEncoder>(gray, width, height);
+    }
+    return std::make_unique<BmpEncoder>(format, width, height);
+}
@@ -0,0 +1,59 @@
+#ifndef CPP_HSE_CODEC_H
+#define CPP_HSE_CODEC_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "../Image/Image.h"
+
+namespace reading_and_writing {
+enum class PixelFormat {
+    // Every channel of every pixel.
+    BGR,
+    // One channel per pixel, for images whose pixels are all gray; the blue channel is
+    // stored. Formats without a gray variant store BGR.
+    GRAY,
+};
+
+// Turns the bytes of an image file into pixels. Implementations parse the headers when
+// they are constructed and throw std::invalid_argument if they are malformed.
+class Decoder {
+public:
+    virtual ~Decoder() = default;
+    virtual size_t GetWidth() const = 0;
+    virtual size_t GetHeight() const = 0;
+    // Fills rows with the leftmost rows.GetWidth() columns of image rows [first_row,
+    // first_row + rows.GetHeight()), which the caller has checked are in the image.
+    virtual void ReadRows(size_t first_row, Image& rows) = 0;
+};
+
+// Turns pixels into the bytes of an image file. Raster formats store every row at a fixed
+// place, so rows can be encoded separately and written in any order. Sequential formats
+// compress rows into a stream that has to be written top-down.
+class Encoder {
+public:
+    virtual ~Encoder() = default;
+    // Bytes before the pixels and after them.
+    virtual std::vector<unsigned char> GetHeader() const = 0;
+    virtual std::vector<unsigned char> GetTrailer() const;
+    // Size of a stored row of a raster format, 0 for a sequential one.
+    virtual size_t GetRowSize() const = 0;
+    // Whether rows are stored from the bottom of the image up. Only raster formats may.
+    virtual bool IsBottomUp() const;
+    // Replaces output with the bytes of rows [begin, end) of image, in the order they are
+    // stored. previous is the pixel stored right before row begin, which sequential formats
+    // may refer to; separately encoded runs of rows are concatenated as they are.
+    virtual void EncodeRows(const Image& image, size_t begin, size_t end, const Color& previous,
+                            std::vector<unsigned char>& output) const = 0;
+};
+
+// The decoder is picked by the signature at the start of the file: BMP, PPM, PGM or QOI.
+std::unique_ptr<Decoder> CreateDecoder(const std::string& path, const MappedFile& file);
+// The encoder is picked by the extension of path: .qoi, .ppm, .pgm, .pnm (PGM for gray
+// images, PPM for others) and BMP for anything else.
+std::unique_ptr<Encoder> CreateEncoder(const std::string& path, PixelFormat format, size_t width, size_t height);
+}  // namespace reading_and_writing
+
+#endif  // CPP_HSE_CODEC_H
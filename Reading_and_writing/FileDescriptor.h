@@ -0,0 +1,29 @@
+#ifndef CPP_HSE_FILE_DESCRIPTOR_H
+#define CPP_HSE_FILE_DESCRIPTOR_H
+
+#include <unistd.h>
+
+namespace reading_and_writing {
+// Owns a POSIX file descriptor and closes it on destruction. A negative descriptor (a failed
+// open) is allowed and is simply not closed.
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int descriptor) : descriptor_(descriptor) {
+    }
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+    ~FileDescriptor() {
+        if (descriptor_ >= 0) {
+            close(descriptor_);
+        }
+    }
+    int Get() const {
+        return descriptor_;
+    }
+
+private:
+    int descriptor_;
+};
+}  // namespace reading_and_writing
+
+#endif  // CPP_HSE_FILE_DESCRIPTOR_H
@@ -0,0 +1,107 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FileDescriptor.h"
+
+namespace {
+// Size of a single read() when the file has to be copied into memory.
+const size_t READ_CHUNK_SIZE = 1 << 20;
+}  // namespace
+
+reading_and_writing::MappedFile::MappedFile(const std::string& path) {
+    FileDescriptor file(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (file.Get() < 0) {
+        if (errno == EACCES) {
+            throw std::invalid_argument(std::string("NO permission to read file ") + path);
+        }
+        throw std::invalid_argument(std::string("File ") + path + std::string(" not found"));
+    }
+    struct stat status = {};
+    if (fstat(file.Get(), &status) != 0) {
+        throw std::runtime_error(std::string("Can't get the size of file ") + path);
+    }
+    if (S_ISDIR(status.st_mode)) {
+        throw std::invalid_argument(std::string("File ") + path + std::string(" is a directory"));
+    }
+    if (S_ISREG(status.st_mode) && status.st_size > 0) {
+        size_ = static_cast<size_t>(status.st_size);
+        void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file.Get(), 0);
+        if (mapping != MAP_FAILED) {
+            mapping_ = mapping;
+            data_ = static_cast<const unsigned char*>(mapping);
+            return;
+        }
+        size_ = 0;
+        buffer_.reserve(static_cast<size_t>(status.st_size));
+    }
+    ReadAll(file.Get());
+}
+
+reading_and_writing::MappedFile::~MappedFile() {
+    if (mapping_ != nullptr) {
+        munmap(mapping_, size_);
+    }
+}
+
+const unsigned char* reading_and_writing::MappedFile::GetData() const {
+    return data_;
+}
+
+size_t reading_and_writing::MappedFile::GetSize() const {
+    return size_;
+}
+
+void reading_and_writing::MappedFile::WillNeed(size_t offset, size_t size) const {
+    Advise(offset, size, MADV_WILLNEED);
+}
+
+void reading_and_writing::MappedFile::DontNeed(size_t offset, size_t size) const {
+    Advise(offset, size, MADV_DONTNEED);
+}
+
+void reading_and_writing::MappedFile::Advise(size_t offset, size_t size, int advice) const {
+    if (mapping_ == nullptr || offset >= size_) {
+        return;
+    }
+    // madvise works on whole pages; only the pages fully inside the range are dropped, the
+    // ones it touches are all read ahead.
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = offset / page_size * page_size;
+    size_t end = std::min(offset + size, size_);
+    if (advice == MADV_DONTNEED) {
+        begin = (offset + page_size - 1) / page_size * page_size;
+        end = end == size_ ? end : end / page_size * page_size;
+    }
+    if (begin < end) {
+        madvise(static_cast<unsigned char*>(mapping_) + begin, end - begin, advice);
+    }
+}
+
+void reading_and_writing::MappedFile::ReadAll(int descriptor) {
+    while (true) {
+        const size_t size = buffer_.size();
+        buffer_.resize(size + READ_CHUNK_SIZE);
+        ssize_t bytes = read(descriptor, buffer_.data() + size, READ_CHUNK_SIZE);
+        if (bytes < 0 && errno == EINTR) {
+            buffer_.resize(size);
+            continue;
+        }
+        if (bytes < 0) {
+            throw std::runtime_error("Error while reading file");
+        }
+        buffer_.resize(size + static_cast<size_t>(bytes));
+        if (bytes == 0) {
+            break;
+        }
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
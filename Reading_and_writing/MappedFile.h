@@ -0,0 +1,38 @@
+#ifndef CPP_HSE_MAPPED_FILE_H
+#define CPP_HSE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace reading_and_writing {
+// Read-only view of a whole file. Regular files are memory-mapped, so nothing is copied
+// until the bytes are used; anything that can't be mapped (pipes, character devices) is
+// read into memory with a few large reads instead.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const unsigned char* GetData() const;
+    size_t GetSize() const;
+
+    // Hints for mapped files, no-ops otherwise: the bytes [offset, offset + size) are about
+    // to be read, or won't be read again and can be dropped from the process' memory.
+    void WillNeed(size_t offset, size_t size) const;
+    void DontNeed(size_t offset, size_t size) const;
+
+private:
+    void Advise(size_t offset, size_t size, int advice) const;
+    void ReadAll(int descriptor);
+
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    void* mapping_ = nullptr;
+    std::vector<unsigned char> buffer_;
+};
+}  // namespace reading_and_writing
+
+#endif  // CPP_HSE_MAPPED_FILE_H
@@ -0,0 +1,148 @@
+#include "Pnm.h"
+
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "Utils.h"
+#include "../Filters/Kernels.h"
+#include "../Threads/Scheduler.h"
+
+namespace {
+const size_t RGB_CHANNELS = 3;
+const size_t GRAY_CHANNELS = 1;
+const char COMMENT = '#';
+// Dimensions are limited like those of BMP files.
+const size_t MAX_NUMBER = std::numeric_limits<int32_t>::max();
+const int DECIMAL_BASE = 10;
+}  // namespace
+
+reading_and_writing::PnmDecoder::PnmDecoder(const std::string& path, const MappedFile& file)
+    : path_(path), file_(file) {
+    const unsigned char* data = file_.GetData();
+    const size_t size = file_.GetSize();
+    const size_t signature_size = image::utils::PPM_SIGNATURE.size();
+    if (size >= signature_size && std::memcmp(data, image::utils::PPM_SIGNATURE.data(), signature_size) == 0) {
+        channels_ = RGB_CHANNELS;
+    } else if (size >= signature_size &&
+               std::memcmp(data, image::utils::PGM_SIGNATURE.data(), signature_size) == 0) {
+        channels_ = GRAY_CHANNELS;
+    } else {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is not a PPM or PGM file"));
+    }
+    size_t position = signature_size;
+    width_ = ParseNumber(position);
+    height_ = ParseNumber(position);
+    if (ParseNumber(position) != image::utils::PNM_MAX_VALUE) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is not an 8-bit PPM or PGM file"));
+    }
+    // A single whitespace character separates the header from the pixels.
+    if (position >= size || !std::isspace(data[position])) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is truncated"));
+    }
+    pixel_array_offset_ = position + 1;
+    const size_t row_size = width_ * channels_;
+    if (row_size != 0 && height_ > (size - pixel_array_offset_) / row_size) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is truncated"));
+    }
+}
+
+size_t reading_and_writing::PnmDecoder::ParseNumber(size_t& position) const {
+    const unsigned char* data = file_.GetData();
+    const size_t size = file_.GetSize();
+    while (position < size && (std::isspace(data[position]) || data[position] == COMMENT)) {
+        if (data[position] == COMMENT) {
+            while (position < size && data[position] != '\n' && data[position] != '\r') {
+                ++position;
+            }
+        } else {
+            ++position;
+        }
+    }
+    if (position >= size || !std::isdigit(data[position])) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" has an invalid header"));
+    }
+    size_t number = 0;
+    for (; position < size && std::isdigit(data[position]); ++position) {
+        number = number * DECIMAL_BASE + (data[position] - '0');
+        if (number > MAX_NUMBER) {
+            throw std::invalid_argument(std::string("File ") + path_ + std::string(" has invalid dimensions"));
+        }
+    }
+    return number;
+}
+
+size_t reading_and_writing::PnmDecoder::GetWidth() const {
+    return width_;
+}
+
+size_t reading_and_writing::PnmDecoder::GetHeight() const {
+    return height_;
+}
+
+void reading_and_writing::PnmDecoder::ReadRows(size_t first_row, Image& rows) {
+    const size_t count = rows.GetHeight();
+    const size_t width = rows.GetWidth();
+    const size_t row_size = width_ * channels_;
+    const size_t begin = pixel_array_offset_ + first_row * row_size;
+    // Reading ahead whole rows only pays off when most of every row is needed.
+    if (width * 2 >= width_) {
+        file_.WillNeed(begin, count * row_size);
+    }
+    threads::ParallelForRows(count, 1, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            const unsigned char* bytes = file_.GetData() + begin + i * row_size;
+            Color* row = rows.GetRow(i);
+            if (channels_ == GRAY_CHANNELS) {
+                for (size_t j = 0; j < width; ++j) {
+                    row[j].blue = row[j].green = row[j].red = bytes[j];
+                }
+                continue;
+            }
+            for (size_t j = 0; j < width; ++j) {
+                row[j].red = bytes[j * RGB_CHANNELS];
+                row[j].green = bytes[j * RGB_CHANNELS + 1];
+                row[j].blue = bytes[j * RGB_CHANNELS + 2];
+            }
+        }
+    });
+    file_.DontNeed(begin, count * row_size);
+}
+
+reading_and_writing::PnmEncoder::PnmEncoder(bool gray, size_t width, size_t height)
+    : gray_(gray), width_(width), height_(height) {
+}
+
+std::vector<unsigned char> reading_and_writing::PnmEncoder::GetHeader() const {
+    const std::vector<char>& signature = gray_ ? image::utils::PGM_SIGNATURE : image::utils::PPM_SIGNATURE;
+    const std::string header = std::string(signature.begin(), signature.end()) + "\n" + std::to_string(width_) + " " +
+                               std::to_string(height_) + "\n" + std::to_string(image::utils::PNM_MAX_VALUE) + "\n";
+    return {header.begin(), header.end()};
+}
+
+size_t reading_and_writing::PnmEncoder::GetRowSize() const {
+    return width_ * (gray_ ? GRAY_CHANNELS : RGB_CHANNELS);
+}
+
+void reading_and_writing::PnmEncoder::EncodeRows(const Image& image, size_t begin, size_t end, const Color&,
+                                                 std::vector<unsigned char>& output) const {
+    const size_t row_size = GetRowSize();
+    output.resize((end - begin) * row_size);
+    unsigned char* bytes = output.data();
+    for (size_t i = begin; i < end; ++i) {
+        const Color* row = image.GetRow(i);
+        if (gray_) {
+            for (size_t j = 0; j < width_; ++j) {
+                bytes[j] = filters::kernels::Gray(row[j].blue, row[j].green, row[j].red);
+            }
+        } else {
+            for (size_t j = 0; j < width_; ++j) {
+                bytes[j * RGB_CHANNELS] = row[j].red;
+                bytes[j * RGB_CHANNELS + 1] = row[j].green;
+                bytes[j * RGB_CHANNELS + 2] = row[j].blue;
+            }
+        }
+        bytes += row_size;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef CPP_HSE_PNM_H
+#define CPP_HSE_PNM_H
+
+#include <string>
+#include <vector>
+
+#include "Codec.h"
+#include "MappedFile.h"
+
+namespace reading_and_writing {
+// Binary PPM (P6, RGB) and PGM (P5, gray) files with a maximum value of 255: a short text
+// header followed by the raw rows, top-down and unpadded.
+class PnmDecoder : public Decoder {
+public:
+    PnmDecoder(const std::string& path, const MappedFile& file);
+    size_t GetWidth() const override;
+    size_t GetHeight() const override;
+    void ReadRows(size_t first_row, Image& rows) override;
+
+private:
+    // Reads the decimal number at position, after any whitespace and comments.
+    size_t ParseNumber(size_t& position) const;
+
+    std::string path_;
+    const MappedFile& file_;
+    size_t width_ = 0;
+    size_t height_ = 0;
+    size_t channels_ = 0;
+    size_t pixel_array_offset_ = 0;
+};
+
+// Writes PPM files, or PGM files holding the luma of each pixel when gray is true.
+class PnmEncoder : public Encoder {
+public:
+    PnmEncoder(bool gray, size_t width, size_t height);
+    std::vector<unsigned char> GetHeader() const override;
+    size_t GetRowSize() const override;
+    void EncodeRows(const Image& image, size_t begin, size_t end, const Color& previous,
+                    std::vector<unsigned char>& output) const override;
+
+private:
+    bool gray_;
+    size_t width_;
+    size_t height_;
+};
+}  // namespace reading_and_writing
+
+#endif  // CPP_HSE_PNM_H
@@ -0,0 +1,238 @@
+#include "Qoi.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+// Chunk tags. The 8-bit ones take precedence over the 2-bit ones they overlap.
+const uint8_t OP_INDEX = 0x00;
+const uint8_t OP_DIFF = 0x40;
+const uint8_t OP_LUMA = 0x80;
+const uint8_t OP_RUN = 0xc0;
+const uint8_t OP_RGB = 0xfe;
+const uint8_t OP_RGBA = 0xff;
+const uint8_t TAG_MASK = 0xc0;
+const uint8_t VALUE_MASK = 0x3f;
+// Runs are stored with a bias of -1; the two largest values would clash with OP_RGB and
+// OP_RGBA.
+const size_t MAX_RUN = 62;
+const uint8_t OPAQUE = 255;
+const uint8_t RGB_CHANNELS = 3;
+const uint8_t SRGB = 0;
+const size_t MAX_DIMENSION = std::numeric_limits<int32_t>::max();
+// Longest chunk: OP_RGBA and four channels.
+const size_t MAX_CHUNK_SIZE = 5;
+const std::vector<unsigned char> END_MARKER = {0, 0, 0, 0, 0, 0, 0, 1};
+const size_t WIDTH_POSITION = 4;
+const size_t HEIGHT_POSITION = 8;
+const size_t CHANNELS_POSITION = 12;
+const size_t COLORSPACE_POSITION = 13;
+
+size_t GetHash(const reading_and_writing::QoiPixel& pixel) {
+    const size_t red_factor = 3;
+    const size_t green_factor = 5;
+    const size_t blue_factor = 7;
+    const size_t alpha_factor = 11;
+    return (pixel.red * red_factor + pixel.green * green_factor + pixel.blue * blue_factor +
+            pixel.alpha * alpha_factor) %
+           image::utils::QOI_INDEX_SIZE;
+}
+
+bool operator==(const reading_and_writing::QoiPixel& first, const reading_and_writing::QoiPixel& second) {
+    return first.red == second.red && first.green == second.green && first.blue == second.blue &&
+           first.alpha == second.alpha;
+}
+
+size_t ReadBigEndian(const unsigned char* bytes) {
+    return static_cast<size_t>(bytes[0]) << 24 | static_cast<size_t>(bytes[1]) << 16 |
+           static_cast<size_t>(bytes[2]) << 8 | bytes[3];
+}
+
+void WriteBigEndian(size_t number, unsigned char* bytes) {
+    bytes[0] = number >> 24;
+    bytes[1] = number >> 16;
+    bytes[2] = number >> 8;
+    bytes[3] = number;
+}
+}  // namespace
+
+reading_and_writing::QoiDecoder::QoiDecoder(const std::string& path, const MappedFile& file)
+    : path_(path), file_(file) {
+    const unsigned char* data = file_.GetData();
+    const size_t size = file_.GetSize();
+    const size_t signature_size = image::utils::QOI_SIGNATURE.size();
+    if (size < signature_size || std::memcmp(data, image::utils::QOI_SIGNATURE.data(), signature_size) != 0) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is not a QOI file"));
+    }
+    if (size < image::utils::QOI_HEADER_SIZE) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is truncated"));
+    }
+    width_ = ReadBigEndian(data + WIDTH_POSITION);
+    height_ = ReadBigEndian(data + HEIGHT_POSITION);
+    if (width_ > MAX_DIMENSION || height_ > MAX_DIMENSION) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" has invalid dimensions"));
+    }
+    // Every byte holds at most a run, which keeps a bogus header from allocating a huge image.
+    if (height_ != 0 && width_ > (size - image::utils::QOI_HEADER_SIZE) * MAX_RUN / height_) {
+        throw std::invalid_argument(std::string("File ") + path_ + std::string(" is truncated"));
+    }
+    Restart();
+}
+
+size_t reading_and_writing::QoiDecoder::GetWidth() const {
+    return width_;
+}
+
+size_t reading_and_writing::QoiDecoder::GetHeight() const {
+    return height_;
+}
+
+void reading_and_writing::QoiDecoder::ReadRows(size_t first_row, Image& rows) {
+    if (first_row < next_row_) {
+        Restart();
+    }
+    while (next_row_ < first_row) {
+        DecodeRow(nullptr, 0);
+    }
+    for (size_t i = 0; i < rows.GetHeight(); ++i) {
+        DecodeRow(rows.GetRow(i), rows.GetWidth());
+    }
+}
+
+void reading_and_writing::QoiDecoder::Restart() {
+    next_row_ = 0;
+    position_ = image::utils::QOI_HEADER_SIZE;
+    run_ = 0;
+    pixel_ = {0, 0, 0, OPAQUE};
+    index_.fill(QoiPixel());
+}
+
+void reading_and_writing::QoiDecoder::DecodeRow(Color* row, size_t width) {
+    const unsigned char* data = file_.GetData();
+    const size_t size = file_.GetSize();
+    for (size_t j = 0; j < width_; ++j) {
+        if (run_ > 0) {
+            --run_;
+        } else {
+            // Valid files end with an 8-byte marker, so a whole chunk is always there.
+            if (position_ + MAX_CHUNK_SIZE > size) {
+                throw std::invalid_argument(std::string("File ") + path_ + std::string(" is truncated"));
+            }
+            const uint8_t tag = data[position_++];
+            if (tag == OP_RGB || tag == OP_RGBA) {
+                pixel_.red = data[position_];
+                pixel_.green = data[position_ + 1];
+                pixel_.blue = data[position_ + 2];
+                position_ += RGB_CHANNELS;
+                if (tag == OP_RGBA) {
+                    pixel_.alpha = data[position_++];
+                }
+            } else if ((tag & TAG_MASK) == OP_INDEX) {
+                pixel_ = index_[tag];
+            } else if ((tag & TAG_MASK) == OP_DIFF) {
+                // Differences of -2..1 per channel, biased by 2.
+                pixel_.red += ((tag >> 4) & 0x03) - 2;
+                pixel_.green += ((tag >> 2) & 0x03) - 2;
+                pixel_.blue += (tag & 0x03) - 2;
+            } else if ((tag & TAG_MASK) == OP_LUMA) {
+                // A green difference of -32..31 and red and blue differences of -8..7 from it.
+                const int green_difference = (tag & VALUE_MASK) - 32;
+                const uint8_t second = data[position_++];
+                pixel_.red += green_difference - 8 + ((second >> 4) & 0x0f);
+                pixel_.green += green_difference;
+                pixel_.blue += green_difference - 8 + (second & 0x0f);
+            } else {
+                run_ = tag & VALUE_MASK;
+            }
+            index_[GetHash(pixel_)] = pixel_;
+        }
+        if (j < width) {
+            row[j].blue = pixel_.blue;
+            row[j].green = pixel_.green;
+            row[j].red = pixel_.red;
+        }
+    }
+    ++next_row_;
+}
+
+reading_and_writing::QoiEncoder::QoiEncoder(size_t width, size_t height) : width_(width), height_(height) {
+}
+
+std::vector<unsigned char> reading_and_writing::QoiEncoder::GetHeader() const {
+    std::vector<unsigned char> header(image::utils::QOI_HEADER_SIZE);
+    std::copy(image::utils::QOI_SIGNATURE.begin(), image::utils::QOI_SIGNATURE.end(), header.begin());
+    WriteBigEndian(width_, header.data() + WIDTH_POSITION);
+    WriteBigEndian(height_, header.data() + HEIGHT_POSITION);
+    header[CHANNELS_POSITION] = RGB_CHANNELS;
+    header[COLORSPACE_POSITION] = SRGB;
+    return header;
+}
+
+std::vector<unsigned char> reading_and_writing::QoiEncoder::GetTrailer() const {
+    return END_MARKER;
+}
+
+size_t reading_and_writing::QoiEncoder::GetRowSize() const {
+    return 0;
+}
+
+// The table starts out empty rather than as the decoder has it after the rows before
+// begin. It only refers to slots it filled itself, which the decoder fills the same way, and
+// empty slots never match a pixel since they have zero alpha. Runs end with the rows.
+void reading_and_writing::QoiEncoder::EncodeRows(const Image& image, size_t begin, size_t end,
+                                                 const Color& previous, std::vector<unsigned char>& output) const {
+    std::array<QoiPixel, image::utils::QOI_INDEX_SIZE> index;
+    QoiPixel last = {previous.red, previous.green, previous.blue, OPAQUE};
+    size_t run = 0;
+    output.resize((end - begin) * width_ * (RGB_CHANNELS + 1));
+    unsigned char* bytes = output.data();
+    for (size_t i = begin; i < end; ++i) {
+        const Color* row = image.GetRow(i);
+        for (size_t j = 0; j < width_; ++j) {
+            const QoiPixel pixel = {row[j].red, row[j].green, row[j].blue, OPAQUE};
+            if (pixel == last) {
+                if (++run == MAX_RUN) {
+                    *bytes++ = OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                *bytes++ = OP_RUN | (run - 1);
+                run = 0;
+            }
+            const size_t hash = GetHash(pixel);
+            if (index[hash] == pixel) {
+                *bytes++ = OP_INDEX | hash;
+                last = pixel;
+                continue;
+            }
+            index[hash] = pixel;
+            const int red_difference = static_cast<int8_t>(pixel.red - last.red);
+            const int green_difference = static_cast<int8_t>(pixel.green - last.green);
+            const int blue_difference = static_cast<int8_t>(pixel.blue - last.blue);
+            const int red_green = red_difference - green_difference;
+            const int blue_green = blue_difference - green_difference;
+            if (red_difference >= -2 && red_difference <= 1 && green_difference >= -2 && green_difference <= 1 &&
+                blue_difference >= -2 && blue_difference <= 1) {
+                *bytes++ = OP_DIFF | (red_difference + 2) << 4 | (green_difference + 2) << 2 | (blue_difference + 2);
+            } else if (green_difference >= -32 && green_difference <= 31 && red_green >= -8 && red_green <= 7 &&
+                       blue_green >= -8 && blue_green <= 7) {
+                *bytes++ = OP_LUMA | (green_difference + 32);
+                *bytes++ = (red_green + 8) << 4 | (blue_green + 8);
+            } else {
+                *bytes++ = OP_RGB;
+                *bytes++ = pixel.red;
+                *bytes++ = pixel.green;
+                *bytes++ = pixel.blue;
+            }
+            last = pixel;
+        }
+    }
+    if (run > 0) {
+        *bytes++ = OP_RUN | (run - 1);
+    }
+    output.resize(static_cast<size_t>(bytes - output.data()));
+}
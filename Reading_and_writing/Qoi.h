@@ -0,0 +1,68 @@
+#ifndef CPP_HSE_QOI_H
+#define CPP_HSE_QOI_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Codec.h"
+#include "MappedFile.h"
+#include "Utils.h"
+
+namespace reading_and_writing {
+// Lossless "Quite OK Image" files: each pixel is coded as a run of the previous one, an
+// index into a table of recently seen colors, a small difference from the previous pixel
+// or the color itself. Alpha is ignored when reading and 255 when writing.
+struct QoiPixel {
+    uint8_t red = 0;
+    uint8_t green = 0;
+    uint8_t blue = 0;
+    uint8_t alpha = 0;
+};
+
+// The stream can only be decoded from the start, so rows are best read top-down; reading
+// rows above the last ones read starts over.
+class QoiDecoder : public Decoder {
+public:
+    QoiDecoder(const std::string& path, const MappedFile& file);
+    size_t GetWidth() const override;
+    size_t GetHeight() const override;
+    void ReadRows(size_t first_row, Image& rows) override;
+
+private:
+    void Restart();
+    // Decodes the next row of the image, keeping its leftmost width pixels in row if it
+    // isn't null.
+    void DecodeRow(Color* row, size_t width);
+
+    std::string path_;
+    const MappedFile& file_;
+    size_t width_ = 0;
+    size_t height_ = 0;
+    // Decoding state after the rows [0, next_row_).
+    size_t next_row_ = 0;
+    size_t position_ = 0;
+    size_t run_ = 0;
+    QoiPixel pixel_;
+    std::array<QoiPixel, image::utils::QOI_INDEX_SIZE> index_;
+};
+
+// Bands of rows are encoded independently, each with a table of its own, so the threads
+// can share the work.
+class QoiEncoder : public Encoder {
+public:
+    QoiEncoder(size_t width, size_t height);
+    std::vector<unsigned char> GetHeader() const override;
+    std::vector<unsigned char> GetTrailer() const override;
+    size_t GetRowSize() const override;
+    void EncodeRows(const Image& image, size_t begin, size_t end, const Color& previous,
+                    std::vector<unsigned char>& output) const override;
+
+private:
+    size_t width_;
+    size_t height_;
+};
+}  // namespace reading_and_writing
+
+#endif  // CPP_HSE_QOI_H
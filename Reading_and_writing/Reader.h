@@ -2,24 +2,43 @@
 #define CPP_HSE_READER_H
 
 #include <algorithm>
-#include <cerrno>
-#include <fstream>
+#include <memory>
 #include <string>
 
-#include "Utils.h"
+#include "Codec.h"
+#include "MappedFile.h"
 #include "../Image/Image.h"
 
 namespace reading_and_writing {
+// Reads BMP, PPM, PGM and QOI files, telling them apart by their first bytes.
 class Reader {
 public:
     explicit Reader(const std::string& filename);
     Image Read();
 
+    // Row access for images that shouldn't be loaded at once: Open maps the file and parses
+    // its header, then any rows can be read in any order. Rows of QOI files are cheapest
+    // read top-down, since they can only be decoded from the start.
+    void Open();
+    // Restricts everything read afterwards, Read included, to the top-left width x height
+    // part of the image (or less, if the image is smaller). Only the bytes of that part
+    // are touched, so a small tile of a huge file costs the tile.
+    void Crop(size_t width, size_t height);
+    const std::string& GetPath() const;
+    // Dimensions of what is read, after Crop.
+    size_t GetWidth() const;
+    size_t GetHeight() const;
+    // Fills rows with the image rows [first_row, first_row + rows.GetHeight()). rows must be
+    // as wide as the image.
+    void ReadRows(size_t first_row, Image& rows) const;
+
 private:
     std::string path_;
-    size_t BytesToRead(unsigned char* bytes) const;
+    std::unique_ptr<MappedFile> file_;
+    std::unique_ptr<Decoder> decoder_;
+    size_t width_ = 0;
+    size_t height_ = 0;
 };
-size_t GetPaddingSize(size_t width);
 }  // namespace reading_and_writing
 
 #endif  // CPP_HSE_READER_H
@@ -1,6 +1,7 @@
 #ifndef CPP_HSE_UTILS_H
 #define CPP_HSE_UTILS_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -22,12 +23,39 @@ const int COLOR_PLANES = 1;
 const int COLOR_PLANES_POSITION = 12;
 const int BITS_PER_PIXEL_POSITION = 14;
 const int BITS_PER_PIXEL = 24;
+const int BGRA_BITS_PER_PIXEL = 32;
+const int GRAY_BITS_PER_PIXEL = 8;
+const int COMPRESSION_POSITION = 16;
+const int COLORS_USED_POSITION = 32;
+// Channel masks of BI_BITFIELDS images follow the 40-byte header, in every header version.
+const int CHANNEL_MASKS_POSITION = 40;
+const int UNCOMPRESSED = 0;
+const int BITFIELDS = 3;
+const uint32_t RED_MASK = 0x00FF0000;
+const uint32_t GREEN_MASK = 0x0000FF00;
+const uint32_t BLUE_MASK = 0x000000FF;
+const int PALETTE_ENTRY_SIZE = 4;
+const int PALETTE_SIZE = 256;
 const std::vector<int> SHIFT_BITS = {8, 16, 24};
 const std::vector<char> HEADER_SIGNATURE = {'B', 'M'};
+// Binary PPM and PGM files, with one byte per channel.
+const std::vector<char> PPM_SIGNATURE = {'P', '6'};
+const std::vector<char> PGM_SIGNATURE = {'P', '5'};
+const int PNM_MAX_VALUE = 255;
+const std::vector<char> QOI_SIGNATURE = {'q', 'o', 'i', 'f'};
+const int QOI_HEADER_SIZE = 14;
+const int QOI_INDEX_SIZE = 64;
 // Filters
 const double RED_FACTOR = 0.299;
 const double GREEN_FACTOR = 0.587;
 const double BLUE_FACTOR = 0.114;
+// The factors above in fixed point with GRAY_SHIFT fractional bits. They add up to exactly
+// 1 << GRAY_SHIFT, so gray pixels map to themselves.
+const int GRAY_SHIFT = 15;
+const int RED_WEIGHT = 9798;
+const int GREEN_WEIGHT = 19235;
+const int BLUE_WEIGHT = 3735;
+const float RECURSIVE_BLUR_MIN_SIGMA = 12.0f;
 const int MAX_COLOR_VALUE = 255;
 const int MIN_COLOR_VALUE = 0;
 }  // namespace image::utils
@@ -1,66 +1,184 @@
 #include "Writer.h"
 
-template <typename T>
-void reading_and_writing::Writer::WriteBytes(T number, unsigned char *bytes) {
-    *bytes = number;
-    for (size_t i = 0; i < image::utils::SHIFT_BITS.size(); ++i) {
-        *(bytes + i + 1) = number >> image::utils::SHIFT_BITS[i];
-    }
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../Threads/Scheduler.h"
+
+namespace {
+// Permissions of newly created files, before the umask is applied.
+const mode_t DEFAULT_FILE_MODE = 0666;
+// Upper bound on the bytes a thread encodes before handing them to the kernel.
+const size_t WRITE_CHUNK_SIZE = 1 << 20;
+}  // namespace
+
+reading_and_writing::Writer::Writer(std::string path, PixelFormat format)
+    : path_(std::move(path)), format_(format) {
 }
 
-void reading_and_writing::Writer::WriteBMPHeader(unsigned char *bmp_header, size_t file_size) {
-    bmp_header[image::utils::FILE_FORMAT_FIRST_POSITION] = image::utils::HEADER_SIGNATURE[0];
-    bmp_header[image::utils::FILE_FORMAT_SECOND_POSITION] = image::utils::HEADER_SIGNATURE[1];
-    WriteBytes(file_size, bmp_header + image::utils::HEADER_FILE_SIZE_OFFSET);
-    bmp_header[image::utils::PIXEL_ARRAY_OFFSET] = image::utils::BMP_HEADER_SIZE + image::utils::DIB_HEADER_SIZE;
+reading_and_writing::Writer::~Writer() {
+    if (!temporary_path_.empty() && file_) {
+        unlink(temporary_path_.c_str());
+    }
 }
 
-void reading_and_writing::Writer::WriteDIBHeader(unsigned char *dib_header, size_t width, size_t height) {
-    dib_header[image::utils::INFORMATION_HEADER_SIZE_POSITION] = image::utils::DIB_HEADER_SIZE;
-    WriteBytes(width, dib_header + image::utils::HEADER_WIDTH_OFFSET);
-    WriteBytes(height, dib_header + image::utils::HEADER_HEIGHT_OFFSET);
-    dib_header[image::utils::COLOR_PLANES_POSITION] = image::utils::COLOR_PLANES;
-    dib_header[image::utils::BITS_PER_PIXEL_POSITION] = image::utils::BITS_PER_PIXEL;
+void reading_and_writing::Writer::Write(const Image &image) {
+    Open(image.GetWidth(), image.GetHeight());
+    WriteRows(0, image);
+    Close();
 }
 
-reading_and_writing::Writer::Writer(const std::string path) : path_(std::move(path)) {
+const std::string &reading_and_writing::Writer::GetPath() const {
+    return path_;
 }
 
-void reading_and_writing::Writer::Write(const Image &image) {
-    std::ofstream out_file;
-    out_file.open(path_, std::ios::out | std::ios::binary);
-    if (!out_file.is_open()) {
+void reading_and_writing::Writer::Open(size_t width, size_t height) {
+    const std::string &target = temporary_path_.empty() ? path_ : temporary_path_;
+    file_ = std::make_unique<FileDescriptor>(
+        open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, DEFAULT_FILE_MODE));
+    if (file_->Get() < 0) {
+        if (errno == EACCES) {
+            throw std::invalid_argument(std::string("Permission denied to file ") + path_);
+        }
         throw std::invalid_argument(std::string("Can't open file ") + path_);
     }
-    if (errno == EACCES) {
-        throw std::invalid_argument(std::string("Permission denied to file ") + path_);
+    width_ = width;
+    height_ = height;
+    rows_in_order_ = 0;
+    previous_ = Color();
+    encoder_ = CreateEncoder(path_, format_, width, height);
+    row_size_ = encoder_->GetRowSize();
+    bottom_up_ = encoder_->IsBottomUp();
+    const std::vector<unsigned char> headers = encoder_->GetHeader();
+    headers_size_ = headers.size();
+
+    struct stat status = {};
+    seekable_ = fstat(file_->Get(), &status) == 0 && S_ISREG(status.st_mode);
+    if (!seekable_ || row_size_ == 0) {
+        WriteInOrder(file_->Get(), headers.data(), headers.size());
+        return;
+    }
+    // Reserving the blocks up front lets rows be written in any order without the file
+    // system growing the file piece by piece.
+    const size_t file_size = headers_size_ + height * row_size_;
+    if (fallocate(file_->Get(), 0, 0, static_cast<off_t>(file_size)) != 0 &&
+        ftruncate(file_->Get(), static_cast<off_t>(file_size)) != 0) {
+        throw std::runtime_error(std::string("Can't allocate space for file ") + path_);
+    }
+    WriteAt(file_->Get(), headers.data(), headers.size(), 0);
+}
+
+bool reading_and_writing::Writer::CanWriteTopDown() const {
+    return (seekable_ && row_size_ != 0) || !bottom_up_;
+}
+
+void reading_and_writing::Writer::WriteRows(size_t first_row, const Image &rows) {
+    const size_t count = rows.GetHeight();
+    if (first_row + count > height_ || rows.GetWidth() != width_) {
+        throw std::out_of_range("Rows are outside of the image");
+    }
+    if (!seekable_ || row_size_ == 0) {
+        const bool in_order = bottom_up_ ? first_row + count == height_ - rows_in_order_ : first_row == rows_in_order_;
+        if (!in_order) {
+            throw std::invalid_argument(std::string("Rows of file ") + path_ + " can only be written " +
+                                        (bottom_up_ ? "bottom-up" : "top-down"));
+        }
+        WriteRowsInOrder(rows);
+        rows_in_order_ += count;
+        return;
     }
-    const size_t file_size = image::utils::BMP_HEADER_SIZE + image::utils::DIB_HEADER_SIZE +
-                             image.GetHeight() * image.GetWidth() * image::utils::BYTES_PER_PIXEL +
-                             GetPaddingSize(image.GetWidth()) * image.GetHeight();
-
-    unsigned char bmp_header[image::utils::BMP_HEADER_SIZE];
-    std::fill(bmp_header, bmp_header + image::utils::BMP_HEADER_SIZE, 0);
-    WriteBMPHeader(bmp_header, file_size);
-
-    unsigned char dib_header[image::utils::DIB_HEADER_SIZE];
-    std::fill(dib_header, dib_header + image::utils::DIB_HEADER_SIZE, 0);
-    WriteDIBHeader(dib_header, image.GetWidth(), image.GetHeight());
-
-    out_file.write(reinterpret_cast<char *>(bmp_header), image::utils::BMP_HEADER_SIZE);
-    out_file.write(reinterpret_cast<char *>(dib_header), image::utils::DIB_HEADER_SIZE);
-
-    unsigned char empty_pix[image::utils::BYTES_PER_PIXEL] = {0, 0, 0};
-    for (size_t i = image.GetHeight(); i-- > 0;) {
-        for (size_t j = 0; j < image.GetWidth(); ++j) {
-            uint8_t blue = static_cast<uint8_t>(image.GetColor(i, j).blue);
-            uint8_t green = static_cast<uint8_t>(image.GetColor(i, j).green);
-            uint8_t red = static_cast<uint8_t>(image.GetColor(i, j).red);
-            unsigned char pixel[image::utils::BYTES_PER_PIXEL] = {blue, green, red};
-            out_file.write(reinterpret_cast<char *>(pixel), image::utils::BYTES_PER_PIXEL);
+
+    // The pool's threads write their bands at the same time. The rows of a band are
+    // contiguous in the file as well, in reverse order if it is bottom-up.
+    const size_t chunk_rows = std::max<size_t>(1, WRITE_CHUNK_SIZE / row_size_);
+    threads::ForEachBand(threads::SplitRows(count), [&](const threads::RowBand &band) {
+        std::vector<unsigned char> buffer;
+        for (size_t begin = band.begin; begin < band.end; begin += chunk_rows) {
+            const size_t end = std::min(band.end, begin + chunk_rows);
+            encoder_->EncodeRows(rows, begin, end, previous_, buffer);
+            const size_t file_row = bottom_up_ ? height_ - first_row - end : first_row + begin;
+            WriteAt(file_->Get(), buffer.data(), buffer.size(), headers_size_ + file_row * row_size_);
+        }
+    });
+}
+
+void reading_and_writing::Writer::WriteRowsInOrder(const Image &rows) {
+    const size_t count = rows.GetHeight();
+    const size_t row_size = row_size_ != 0 ? row_size_ : width_ * sizeof(Color);
+    const size_t chunk_rows = std::max<size_t>(1, WRITE_CHUNK_SIZE / std::max<size_t>(1, row_size));
+    // Each thread encodes a chunk of every group into a buffer of its own, then the buffers
+    // are written one after another.
+    const size_t group_rows = chunk_rows * threads::GetThreadCount();
+    std::vector<std::vector<unsigned char>> buffers;
+    for (size_t group = 0; group < count; group += group_rows) {
+        const size_t group_size = std::min(group_rows, count - group);
+        const size_t group_begin = bottom_up_ ? count - group - group_size : group;
+        const std::vector<threads::RowBand> bands = threads::SplitRows(group_size);
+        buffers.resize(bands.size());
+        threads::ForEachBand(bands, [&](const threads::RowBand &band) {
+            const size_t begin = group_begin + band.begin;
+            const Color &previous = begin > 0 && width_ > 0 ? rows.GetRow(begin - 1)[width_ - 1] : previous_;
+            encoder_->EncodeRows(rows, begin, group_begin + band.end, previous, buffers[band.index]);
+        });
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            const std::vector<unsigned char> &buffer = buffers[bottom_up_ ? buffers.size() - 1 - i : i];
+            WriteInOrder(file_->Get(), buffer.data(), buffer.size());
+        }
+    }
+    if (count > 0 && width_ > 0) {
+        previous_ = rows.GetRow(count - 1)[width_ - 1];
+    }
+}
+
+void reading_and_writing::Writer::Close() {
+    if (file_ && encoder_) {
+        const std::vector<unsigned char> trailer = encoder_->GetTrailer();
+        WriteInOrder(file_->Get(), trailer.data(), trailer.size());
+    }
+    const bool opened = file_ && file_->Get() >= 0;
+    file_.reset();
+    encoder_.reset();
+    if (opened && !temporary_path_.empty() && rename(temporary_path_.c_str(), path_.c_str()) != 0) {
+        unlink(temporary_path_.c_str());
+        throw std::runtime_error(std::string("Can't replace file ") + path_);
+    }
+}
+
+void reading_and_writing::Writer::ReplaceOnClose() {
+    temporary_path_ = path_ + "." + std::to_string(getpid()) + ".tmp";
+}
+
+void reading_and_writing::Writer::WriteAt(int descriptor, const unsigned char *data, size_t size,
+                                          size_t offset) const {
+    while (size > 0) {
+        ssize_t bytes = pwrite(descriptor, data, size, static_cast<off_t>(offset));
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            throw std::runtime_error(std::string("Error while writing file ") + path_);
+        }
+        data += bytes;
+        size -= static_cast<size_t>(bytes);
+        offset += static_cast<size_t>(bytes);
+    }
+}
+
+void reading_and_writing::Writer::WriteInOrder(int descriptor, const unsigned char *data, size_t size) const {
+    while (size > 0) {
+        ssize_t bytes = write(descriptor, data, size);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            throw std::runtime_error(std::string("Error while writing file ") + path_);
         }
-        out_file.write(reinterpret_cast<char *>(empty_pix),
-                       static_cast<std::streamsize>(GetPaddingSize(image.GetWidth())));
+        data += bytes;
+        size -= static_cast<size_t>(bytes);
     }
-    out_file.close();
 }
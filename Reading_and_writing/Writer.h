@@ -2,28 +2,65 @@
 #define CPP_HSE_WRITER_H
 
 #include <algorithm>
+#include <memory>
 #include <string>
-#include <fstream>
 #include <utility>
+#include <vector>
 
-#include "Reader.h"
-#include "Utils.h"
+#include "Codec.h"
+#include "FileDescriptor.h"
 #include "../Image/Image.h"
 
 namespace reading_and_writing {
+// Writes BMP, PPM, PGM or QOI files, picked by the extension of the file name (see
+// CreateEncoder). Rows of raster formats are encoded and written by all threads at once:
+// regular files are sized up front and each thread writes its own band of rows with
+// pwrite. QOI streams and unseekable outputs get their bytes written in order, still
+// encoded by all threads a band each.
 class Writer {
 public:
-    explicit Writer(std::string filename);
+    explicit Writer(std::string filename, PixelFormat format = PixelFormat::BGR);
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+    // Removes the temporary file of ReplaceOnClose if Close didn't get to rename it.
+    ~Writer();
     void Write(const Image& image);
+    const std::string& GetPath() const;
 
-private:
-    void WriteDIBHeader(unsigned char* dib_header, size_t width, size_t height);
-    void WriteBMPHeader(unsigned char* bmp_header, size_t file_size);
+    // Row access for images that are produced piece by piece: Open creates the file for a
+    // width x height image, then WriteRows stores rows [first_row, first_row +
+    // rows.GetHeight()). Raster formats written to seekable files take rows in any order,
+    // other outputs only in file order: bottom-up for BMP, top-down for the rest.
+    void Open(size_t width, size_t height);
+    bool CanWriteTopDown() const;
+    void WriteRows(size_t first_row, const Image& rows);
+    void Close();
+    // Makes Open create a temporary file next to the output and Close rename it over the
+    // output, so that the output can be a file that is still being read.
+    void ReplaceOnClose();
 
-    template <typename T>
-    void WriteBytes(T number, unsigned char* bytes);
+private:
+    // Writes rows in file order with write(), encoding bands of them in parallel.
+    void WriteRowsInOrder(const Image& rows);
+    void WriteAt(int descriptor, const unsigned char* data, size_t size, size_t offset) const;
+    void WriteInOrder(int descriptor, const unsigned char* data, size_t size) const;
 
     std::string path_;
+    // Where Open writes when it isn't path_, see ReplaceOnClose.
+    std::string temporary_path_;
+    PixelFormat format_;
+    std::unique_ptr<FileDescriptor> file_;
+    std::unique_ptr<Encoder> encoder_;
+    size_t headers_size_ = 0;
+    size_t width_ = 0;
+    size_t height_ = 0;
+    // 0 for sequential formats.
+    size_t row_size_ = 0;
+    bool bottom_up_ = false;
+    bool seekable_ = false;
+    // Rows written in file order so far, and the last pixel written.
+    size_t rows_in_order_ = 0;
+    Color previous_;
 };
 }  // namespace reading_and_writing
 
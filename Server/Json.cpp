@@ -0,0 +1,286 @@
+#include "Json.h"
+
+#include <cctype>
+#include <cstdio>
+#include <stdexcept>
+
+namespace server {
+namespace {
+// Arrays and objects nest at most this deep. Values are parsed recursively, so a deeper
+// document could overflow the stack of the whole server.
+const size_t MAX_JSON_DEPTH = 64;
+}  // namespace
+
+class JsonValue::Parser {
+public:
+    explicit Parser(const std::string& text) : text_(text) {
+    }
+
+    JsonValue ParseDocument() {
+        JsonValue value = ParseValue();
+        SkipSpaces();
+        if (position_ != text_.size()) {
+            Fail("unexpected text after the value");
+        }
+        return value;
+    }
+
+private:
+    const std::string& text_;
+    size_t position_ = 0;
+    // Arrays and objects the value being parsed is in.
+    size_t depth_ = 0;
+
+    [[noreturn]] void Fail(const std::string& reason) const {
+        throw std::invalid_argument("Invalid JSON at position " + std::to_string(position_) + ": " + reason);
+    }
+
+    void SkipSpaces() {
+        while (position_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[position_]))) {
+            ++position_;
+        }
+    }
+
+    bool Consume(char c) {
+        SkipSpaces();
+        if (position_ < text_.size() && text_[position_] == c) {
+            ++position_;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char c) {
+        if (!Consume(c)) {
+            Fail(std::string("expected '") + c + "'");
+        }
+    }
+
+    JsonValue ParseValue() {
+        SkipSpaces();
+        const size_t begin = position_;
+        JsonValue value;
+        if (position_ >= text_.size()) {
+            Fail("unexpected end");
+        }
+        const char c = text_[position_];
+        if ((c == '{' || c == '[') && depth_ == MAX_JSON_DEPTH) {
+            Fail("nested deeper than " + std::to_string(MAX_JSON_DEPTH) + " levels");
+        }
+        if (c == '{') {
+            value.type_ = Type::OBJECT;
+            ++position_;
+            if (!Consume('}')) {
+                do {
+                    SkipSpaces();
+                    std::string key = ParseString();
+                    Expect(':');
+                    ++depth_;
+                    value.object_[key] = ParseValue();
+                    --depth_;
+                } while (Consume(','));
+                Expect('}');
+            }
+        } else if (c == '[') {
+            value.type_ = Type::ARRAY;
+            ++position_;
+            if (!Consume(']')) {
+                do {
+                    ++depth_;
+                    value.array_.push_back(ParseValue());
+                    --depth_;
+                } while (Consume(','));
+                Expect(']');
+            }
+        } else if (c == '"') {
+            value.type_ = Type::STRING;
+            value.string_ = ParseString();
+        } else if (ParseKeyword("true") || ParseKeyword("false")) {
+            value.type_ = Type::BOOLEAN;
+        } else if (ParseKeyword("null")) {
+            value.type_ = Type::NULL_VALUE;
+        } else {
+            value.type_ = Type::NUMBER;
+            ParseNumber();
+        }
+        value.text_ = text_.substr(begin, position_ - begin);
+        return value;
+    }
+
+    bool ParseKeyword(const std::string& keyword) {
+        if (text_.compare(position_, keyword.size(), keyword) == 0) {
+            position_ += keyword.size();
+            return true;
+        }
+        return false;
+    }
+
+    void ParseNumber() {
+        const size_t begin = position_;
+        while (position_ < text_.size() && (std::isdigit(static_cast<unsigned char>(text_[position_])) ||
+                                            std::string("+-.eE").find(text_[position_]) != std::string::npos)) {
+            ++position_;
+        }
+        try {
+            size_t length = 0;
+            std::stod(text_.substr(begin, position_ - begin), &length);
+            if (length == position_ - begin) {
+                return;
+            }
+        } catch (const std::logic_error&) {
+        }
+        position_ = begin;
+        Fail("expected a value");
+    }
+
+    std::string ParseString() {
+        if (position_ >= text_.size() || text_[position_] != '"') {
+            Fail("expected a string");
+        }
+        ++position_;
+        std::string result;
+        while (position_ < text_.size() && text_[position_] != '"') {
+            char c = text_[position_++];
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (position_ >= text_.size()) {
+                break;
+            }
+            c = text_[position_++];
+            switch (c) {
+                case 'b':
+                    result += '\b';
+                    break;
+                case 'f':
+                    result += '\f';
+                    break;
+                case 'n':
+                    result += '\n';
+                    break;
+                case 'r':
+                    result += '\r';
+                    break;
+                case 't':
+                    result += '\t';
+                    break;
+                case 'u':
+                    AppendCodePoint(ParseHex(), result);
+                    break;
+                default:
+                    result += c;
+            }
+        }
+        if (position_ >= text_.size()) {
+            Fail("unterminated string");
+        }
+        ++position_;
+        return result;
+    }
+
+    unsigned ParseHex() {
+        if (position_ + 4 > text_.size()) {
+            Fail("bad escape");
+        }
+        unsigned code = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            const char c = text_[position_++];
+            if (!std::isxdigit(static_cast<unsigned char>(c))) {
+                Fail("bad escape");
+            }
+            code = code * 16 + static_cast<unsigned>(std::isdigit(static_cast<unsigned char>(c))
+                                                         ? c - '0'
+                                                         : std::tolower(static_cast<unsigned char>(c)) - 'a' + 10);
+        }
+        return code;
+    }
+
+    // UTF-8 encoding of a \u escape. Surrogate pairs are combined, lone surrogates are kept
+    // as they are.
+    void AppendCodePoint(unsigned code, std::string& result) {
+        if (code >= 0xD800 && code < 0xDC00 && text_.compare(position_, 2, "\\u") == 0) {
+            const size_t backup = position_;
+            position_ += 2;
+            const unsigned low = ParseHex();
+            if (low >= 0xDC00 && low < 0xE000) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            } else {
+                position_ = backup;
+            }
+        }
+        if (code < 0x80) {
+            result += static_cast<char>(code);
+        } else if (code < 0x800) {
+            result += static_cast<char>(0xC0 | (code >> 6));
+            result += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            result += static_cast<char>(0xE0 | (code >> 12));
+            result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            result += static_cast<char>(0xF0 | (code >> 18));
+            result += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+};
+
+JsonValue JsonValue::Parse(const std::string& text) {
+    return Parser(text).ParseDocument();
+}
+
+JsonValue::Type JsonValue::GetType() const {
+    return type_;
+}
+
+const std::string& JsonValue::GetString() const {
+    return string_;
+}
+
+const std::vector<JsonValue>& JsonValue::GetArray() const {
+    return array_;
+}
+
+const JsonValue* JsonValue::Find(const std::string& key) const {
+    auto it = object_.find(key);
+    return it == object_.end() ? nullptr : &it->second;
+}
+
+const std::string& JsonValue::GetText() const {
+    return text_;
+}
+
+std::string QuoteJson(const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"':
+                result += "\\\"";
+                break;
+            case '\\':
+                result += "\\\\";
+                break;
+            case '\n':
+                result += "\\n";
+                break;
+            case '\r':
+                result += "\\r";
+                break;
+            case '\t':
+                result += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escape[7];
+                    std::snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+                    result += escape;
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result + "\"";
+}
+}  // namespace server
@@ -0,0 +1,40 @@
+#ifndef CPP_HSE_JSON_H
+#define CPP_HSE_JSON_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace server {
+// Parsed JSON value. Enough of JSON for job requests: all value types are accepted,
+// numbers are kept as doubles, and every value remembers its source text so it can be
+// echoed back unchanged.
+class JsonValue {
+public:
+    enum class Type { NULL_VALUE, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+    // Parses a whole JSON document, throws std::invalid_argument if it isn't one.
+    static JsonValue Parse(const std::string& text);
+
+    Type GetType() const;
+    const std::string& GetString() const;
+    const std::vector<JsonValue>& GetArray() const;
+    // Member of an object, nullptr if there is none.
+    const JsonValue* Find(const std::string& key) const;
+    const std::string& GetText() const;
+
+private:
+    class Parser;
+
+    Type type_ = Type::NULL_VALUE;
+    std::string string_;
+    std::vector<JsonValue> array_;
+    std::map<std::string, JsonValue> object_;
+    std::string text_;
+};
+
+// text as a JSON string literal, quotes included.
+std::string QuoteJson(const std::string& text);
+}  // namespace server
+
+#endif  // CPP_HSE_JSON_H
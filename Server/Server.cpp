@@ -0,0 +1,451 @@
+#include "Server.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Json.h"
+#include "../Pipeline/Pipeline.h"
+#include "../Pipeline/Streaming.h"
+#include "../Reading_and_writing/FileDescriptor.h"
+#include "../Reading_and_writing/Reader.h"
+#include "../Reading_and_writing/Writer.h"
+#include "../Threads/BoundedQueue.h"
+#include "../Threads/Scheduler.h"
+
+namespace server {
+namespace {
+const size_t JOB_QUEUE_CAPACITY = 64;
+const size_t MAX_REQUEST_SIZE = 1 << 20;
+const size_t READ_BUFFER_SIZE = 1 << 16;
+const int LISTEN_BACKLOG = 64;
+const char* const PROGRAM_NAME = "image_processor";
+
+using Clock = std::chrono::steady_clock;
+
+// Both ends of a pipe that the signal handler writes to. The pipe is never drained, so once
+// a stop signal has arrived, every poll on the read end reports it.
+int stop_pipe[2] = {-1, -1};
+
+void HandleStopSignal(int) {
+    const char byte = 0;
+    [[maybe_unused]] ssize_t written = write(stop_pipe[1], &byte, 1);
+}
+
+// Routes SIGTERM and SIGINT to the stop pipe while it exists. SIGPIPE is ignored, so a
+// client that disconnects early only makes its own responses fail.
+class StopSignal {
+public:
+    StopSignal() {
+        if (pipe2(stop_pipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+            throw std::runtime_error("Can't create the stop signal pipe");
+        }
+        struct sigaction action = {};
+        action.sa_handler = HandleStopSignal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGTERM, &action, &previous_term_);
+        sigaction(SIGINT, &action, &previous_int_);
+        action.sa_handler = SIG_IGN;
+        sigaction(SIGPIPE, &action, &previous_pipe_);
+    }
+    StopSignal(const StopSignal&) = delete;
+    StopSignal& operator=(const StopSignal&) = delete;
+    ~StopSignal() {
+        sigaction(SIGTERM, &previous_term_, nullptr);
+        sigaction(SIGINT, &previous_int_, nullptr);
+        sigaction(SIGPIPE, &previous_pipe_, nullptr);
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        stop_pipe[0] = stop_pipe[1] = -1;
+    }
+    int GetDescriptor() const {
+        return stop_pipe[0];
+    }
+
+private:
+    struct sigaction previous_term_ = {};
+    struct sigaction previous_int_ = {};
+    struct sigaction previous_pipe_ = {};
+};
+
+// Waits until descriptor is readable or a stop signal arrives; true in the first case.
+bool WaitReadable(int descriptor, const StopSignal& stop) {
+    pollfd descriptors[2] = {{descriptor, POLLIN, 0}, {stop.GetDescriptor(), POLLIN, 0}};
+    while (true) {
+        if (poll(descriptors, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (descriptors[1].revents != 0) {
+            return false;
+        }
+        if (descriptors[0].revents != 0) {
+            return true;
+        }
+    }
+}
+
+// Where the responses of one client go. Executors answer from several threads at once,
+// so whole lines are written under a lock.
+class Responder {
+public:
+    explicit Responder(int descriptor, bool owned = false)
+        : descriptor_(descriptor), owned_(owned ? std::make_unique<reading_and_writing::FileDescriptor>(descriptor) : nullptr) {
+    }
+    int GetDescriptor() const {
+        return descriptor_;
+    }
+    void Send(const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const char* data = line.data();
+        size_t size = line.size();
+        while (size > 0) {
+            ssize_t bytes = write(descriptor_, data, size);
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes <= 0) {
+                // The client is gone, there is no one left to tell.
+                return;
+            }
+            data += bytes;
+            size -= static_cast<size_t>(bytes);
+        }
+    }
+
+private:
+    int descriptor_;
+    std::unique_ptr<reading_and_writing::FileDescriptor> owned_;
+    std::mutex mutex_;
+};
+
+struct Job {
+    std::string request;
+    // Set when the request couldn't even be read; the job is answered with it.
+    std::string error;
+    std::shared_ptr<Responder> responder;
+    Clock::time_point received;
+};
+
+double GetMilliseconds(Clock::time_point begin, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+const std::string& GetStringMember(const JsonValue& request, const std::string& key) {
+    const JsonValue* value = request.Find(key);
+    if (value == nullptr || value->GetType() != JsonValue::Type::STRING) {
+        throw std::invalid_argument("Job requires a string \"" + key + "\"");
+    }
+    return value->GetString();
+}
+
+// Command line arguments of a job: the program name, the paths and the filters.
+std::vector<std::string> GetArguments(const JsonValue& request) {
+    std::vector<std::string> arguments = {PROGRAM_NAME, GetStringMember(request, "input"),
+                                          GetStringMember(request, "output")};
+    const JsonValue* filters = request.Find("filters");
+    if (filters == nullptr) {
+        return arguments;
+    }
+    if (filters->GetType() == JsonValue::Type::STRING) {
+        std::istringstream stream(filters->GetString());
+        std::string argument;
+        while (stream >> argument) {
+            arguments.push_back(argument);
+        }
+        return arguments;
+    }
+    if (filters->GetType() != JsonValue::Type::ARRAY) {
+        throw std::invalid_argument("Job \"filters\" must be a string or an array of strings");
+    }
+    for (const JsonValue& argument : filters->GetArray()) {
+        if (argument.GetType() != JsonValue::Type::STRING) {
+            throw std::invalid_argument("Job \"filters\" must be a string or an array of strings");
+        }
+        arguments.push_back(argument.GetString());
+    }
+    return arguments;
+}
+
+// Jobs may only ask to be streamed. The other options set up the process, which the
+// server does from its own command line, or print what the response has no room for, so a
+// job that uses one fails rather than have it ignored.
+void RejectOptions(const std::vector<parser::Token>& tokens) {
+    for (size_t i = 2; i < tokens.size(); ++i) {
+        if (pipeline::IsOption(tokens[i]) && tokens[i].name != "--stream") {
+            throw std::invalid_argument("Jobs can't use " + tokens[i].name);
+        }
+    }
+}
+
+// Runs jobs on one thread, keeping the image buffers for the next job.
+class Executor {
+public:
+    void Run(const Job& job) {
+        const Clock::time_point start = Clock::now();
+        std::string id = "null";
+        std::ostringstream response;
+        response << std::fixed << std::setprecision(3);
+        try {
+            if (!job.error.empty()) {
+                throw std::invalid_argument(job.error);
+            }
+            const JsonValue request = JsonValue::Parse(job.request);
+            if (request.GetType() != JsonValue::Type::OBJECT) {
+                throw std::invalid_argument("Job must be a JSON object");
+            }
+            if (const JsonValue* value = request.Find("id")) {
+                id = value->GetText();
+            }
+            std::ostringstream timings;
+            timings << std::fixed << std::setprecision(3);
+            Execute(GetArguments(request), timings);
+            response << "{\"id\": " << id << ", \"status\": \"ok\", \"queue_ms\": "
+                     << GetMilliseconds(job.received, start) << timings.str();
+        } catch (const std::exception& e) {
+            response.str("");
+            response << "{\"id\": " << id << ", \"status\": \"error\", \"error\": " << QuoteJson(e.what())
+                     << ", \"queue_ms\": " << GetMilliseconds(job.received, start);
+        }
+        response << ", \"total_ms\": " << GetMilliseconds(job.received, Clock::now()) << "}\n";
+        job.responder->Send(response.str());
+    }
+
+private:
+    Image image_;
+    Image buffer_;
+
+    void Execute(const std::vector<std::string>& arguments, std::ostream& timings) {
+        std::vector<char*> argv;
+        for (const std::string& argument : arguments) {
+            argv.push_back(const_cast<char*>(argument.c_str()));
+        }
+        std::vector<parser::Token> tokens = parser::Parse(static_cast<int>(argv.size()), argv.data());
+        RejectOptions(tokens);
+        const pipeline::Options options = pipeline::ExtractOptions(tokens);
+        const pipeline::FilterChain chain = pipeline::Compile({tokens.begin() + 2, tokens.end()});
+        reading_and_writing::Reader reader(tokens[0].name);
+        reading_and_writing::Writer writer(tokens[1].name, pipeline::GetOutputFormat(chain));
+        reader.Open();
+        pipeline::PushDownCrop(chain, reader);
+        if (options.stream) {
+            pipeline::RunStreaming(chain, reader, writer);
+            return;
+        }
+        const Clock::time_point start = Clock::now();
+        image_.Reshape(reader.GetWidth(), reader.GetHeight());
+        reader.ReadRows(0, image_);
+        const Clock::time_point read = Clock::now();
+        pipeline::Run(chain, image_, buffer_);
+        const Clock::time_point filtered = Clock::now();
+        writer.Write(image_);
+        timings << ", \"read_ms\": " << GetMilliseconds(start, read)
+                << ", \"filter_ms\": " << GetMilliseconds(read, filtered)
+                << ", \"write_ms\": " << GetMilliseconds(filtered, Clock::now());
+    }
+};
+
+// The bounded job queue and the executor threads that empty it.
+class JobRunner {
+public:
+    JobRunner() : queue_(JOB_QUEUE_CAPACITY) {
+        for (size_t i = 0; i < threads::GetThreadCount(); ++i) {
+            executors_.emplace_back([this] {
+                // Jobs are spread over the executors, so every job runs on one thread.
+                threads::SerialScope serial;
+                Executor executor;
+                Job job;
+                while (queue_.Pop(job)) {
+                    executor.Run(job);
+                    job = Job();
+                }
+            });
+        }
+    }
+    JobRunner(const JobRunner&) = delete;
+    JobRunner& operator=(const JobRunner&) = delete;
+    ~JobRunner() {
+        Drain();
+    }
+
+    // Queues a job, waiting while the queue is full. Fails once draining has started.
+    bool Submit(Job job) {
+        return queue_.Push(std::move(job));
+    }
+
+    // Finishes the queued jobs and stops the executors.
+    void Drain() {
+        queue_.Close();
+        for (std::thread& executor : executors_) {
+            if (executor.joinable()) {
+                executor.join();
+            }
+        }
+    }
+
+private:
+    threads::BoundedQueue<Job> queue_;
+    std::vector<std::thread> executors_;
+};
+
+// Reads request lines from input and queues them until the input ends or a stop signal
+// arrives.
+void ReadJobs(int input, const std::shared_ptr<Responder>& responder, const StopSignal& stop, JobRunner& runner) {
+    std::string pending;
+    std::vector<char> buffer(READ_BUFFER_SIZE);
+    bool discarding = false;
+    auto submit = [&](Job job) {
+        job.responder = responder;
+        job.received = Clock::now();
+        if (!runner.Submit(std::move(job))) {
+            responder->Send("{\"id\": null, \"status\": \"error\", \"error\": \"Server is shutting down\"}\n");
+        }
+    };
+    while (WaitReadable(input, stop)) {
+        ssize_t bytes = read(input, buffer.data(), buffer.size());
+        if (bytes < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+        if (bytes <= 0) {
+            break;
+        }
+        pending.append(buffer.data(), static_cast<size_t>(bytes));
+        size_t line_begin = 0;
+        for (size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n', line_begin)) {
+            std::string line = pending.substr(line_begin, end - line_begin);
+            line_begin = end + 1;
+            if (discarding) {
+                discarding = false;
+            } else if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                submit({line, "", nullptr, {}});
+            }
+        }
+        pending.erase(0, line_begin);
+        if (pending.size() > MAX_REQUEST_SIZE) {
+            // The rest of the line up to the next newline belongs to the same request.
+            if (!discarding) {
+                submit({"", "Request is longer than " + std::to_string(MAX_REQUEST_SIZE) + " bytes", nullptr, {}});
+            }
+            discarding = true;
+            pending.clear();
+        }
+    }
+    if (!pending.empty() && !discarding && pending.find_first_not_of(" \t\r") != std::string::npos) {
+        submit({pending, "", nullptr, {}});
+    }
+}
+
+class Listener {
+public:
+    explicit Listener(const std::string& path) : path_(path), socket_(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) {
+        if (socket_.Get() < 0) {
+            throw std::runtime_error("Can't create a socket");
+        }
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::invalid_argument("Socket path " + path + " is too long");
+        }
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        if (bind(socket_.Get(), reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            // A socket file nobody listens on is left over from a server that died; it is
+            // replaced. A live one is not.
+            struct stat status = {};
+            const bool stale = errno == EADDRINUSE && stat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode) &&
+                               !IsListening(address);
+            if (!stale || unlink(path.c_str()) != 0 ||
+                bind(socket_.Get(), reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                throw std::invalid_argument("Can't listen on socket " + path + ": " + std::strerror(errno));
+            }
+        }
+        bound_ = true;
+        if (listen(socket_.Get(), LISTEN_BACKLOG) != 0) {
+            throw std::runtime_error("Can't listen on socket " + path + ": " + std::strerror(errno));
+        }
+    }
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+    ~Listener() {
+        if (bound_) {
+            unlink(path_.c_str());
+        }
+    }
+    int GetDescriptor() const {
+        return socket_.Get();
+    }
+
+private:
+    std::string path_;
+    reading_and_writing::FileDescriptor socket_;
+    bool bound_ = false;
+
+    static bool IsListening(const sockaddr_un& address) {
+        reading_and_writing::FileDescriptor probe(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        return probe.Get() >= 0 &&
+               connect(probe.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    }
+};
+
+struct ClientThread {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> finished;
+};
+}  // namespace
+
+void ServeSocket(const std::string& path) {
+    StopSignal stop;
+    Listener listener(path);
+    JobRunner runner;
+    std::vector<ClientThread> clients;
+    while (WaitReadable(listener.GetDescriptor(), stop)) {
+        int client = accept4(listener.GetDescriptor(), nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            continue;
+        }
+        // Threads of clients that have disconnected are joined as new ones arrive.
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (*it->finished) {
+                it->thread.join();
+                it = clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto responder = std::make_shared<Responder>(client, true);
+        auto finished = std::make_shared<std::atomic<bool>>(false);
+        clients.push_back({std::thread([responder, finished, &stop, &runner] {
+                               ReadJobs(responder->GetDescriptor(), responder, stop, runner);
+                               *finished = true;
+                           }),
+                           finished});
+    }
+    for (ClientThread& client : clients) {
+        client.thread.join();
+    }
+    runner.Drain();
+}
+
+void ServeStandardStreams() {
+    StopSignal stop;
+    JobRunner runner;
+    ReadJobs(STDIN_FILENO, std::make_shared<Responder>(STDOUT_FILENO), stop, runner);
+    runner.Drain();
+}
+}  // namespace server
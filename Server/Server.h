@@ -0,0 +1,27 @@
+#ifndef CPP_HSE_SERVER_H
+#define CPP_HSE_SERVER_H
+
+#include <string>
+
+namespace server {
+// Long-running mode that takes jobs as newline-delimited JSON objects:
+//   {"id": 1, "input": "in.bmp", "output": "out.bmp", "filters": "-crop 100 100 -gs"}
+// "filters" is either one string split at spaces or an array of arguments, read like
+// the command line; the only option a job may use is --stream. "id" is optional and
+// echoed back. Every job gets a response line:
+//   {"id": 1, "status": "ok", "queue_ms": ..., "read_ms": ..., "filter_ms": ..., "write_ms": ...,
+//    "total_ms": ...}
+//   {"id": 1, "status": "error", "error": "...", "queue_ms": ..., "total_ms": ...}
+// Jobs run on GetThreadCount() executor threads, each keeping its image buffers from job
+// to job. Requests wait in a bounded queue; when it is full, the server stops reading
+// until there is room again. SIGTERM or SIGINT stop reading new jobs, the queued ones
+// are finished and answered before the server returns.
+
+// Listens on a UNIX domain socket at path; any number of clients may connect at once and
+// get the responses to their jobs in completion order.
+void ServeSocket(const std::string& path);
+// Reads jobs from standard input until it ends and writes responses to standard output.
+void ServeStandardStreams();
+}  // namespace server
+
+#endif  // CPP_HSE_SERVER_H
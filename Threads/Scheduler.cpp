@@ -0,0 +1,126 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+namespace threads {
+namespace {
+// Several bands per thread let work stealing even out bands of uneven cost.
+const size_t BANDS_PER_THREAD = 4;
+const size_t MIN_BAND_ROWS = 8;
+const auto IDLE_WAIT = std::chrono::microseconds(100);
+
+std::mutex pool_mutex;
+std::unique_ptr<ThreadPool> pool;
+size_t thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+thread_local bool serial = false;
+
+struct BandGroup {
+    std::atomic<size_t> remaining = 0;
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+
+    void Run(const std::function<void(const RowBand&)>& body, const RowBand& band) {
+        try {
+            body(band);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        // Decremented under the lock: the waiting thread takes it before destroying
+        // the group, so the group outlives this notification.
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--remaining == 0) {
+            done.notify_all();
+        }
+    }
+};
+}  // namespace
+
+void SetThreadCount(size_t count) {
+    if (count == 0) {
+        throw std::invalid_argument("Thread count must be positive");
+    }
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    thread_count = count;
+    pool.reset();
+}
+
+size_t GetThreadCount() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    return thread_count;
+}
+
+ThreadPool& GetPool() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!pool) {
+        pool = std::make_unique<ThreadPool>(thread_count - 1);
+    }
+    return *pool;
+}
+
+std::vector<RowBand> SplitRows(size_t rows, size_t alignment, size_t halo) {
+    alignment = std::max<size_t>(alignment, 1);
+    const size_t max_bands = (serial ? 1 : GetThreadCount()) * BANDS_PER_THREAD;
+    size_t band_rows = (rows + max_bands - 1) / max_bands;
+    band_rows = std::max({band_rows, halo, MIN_BAND_ROWS});
+    band_rows = (band_rows + alignment - 1) / alignment * alignment;
+
+    std::vector<RowBand> bands;
+    for (size_t begin = 0; begin < rows; begin += band_rows) {
+        bands.push_back({bands.size(), begin, std::min(begin + band_rows, rows)});
+    }
+    return bands;
+}
+
+void ForEachBand(const std::vector<RowBand>& bands, const std::function<void(const RowBand&)>& body) {
+    if (serial) {
+        for (const RowBand& band : bands) {
+            body(band);
+        }
+        return;
+    }
+    ThreadPool& thread_pool = GetPool();
+    if (bands.size() <= 1 || thread_pool.GetWorkerCount() == 0) {
+        for (const RowBand& band : bands) {
+            body(band);
+        }
+        return;
+    }
+    BandGroup group;
+    group.remaining = bands.size();
+    for (size_t i = 1; i < bands.size(); ++i) {
+        thread_pool.Submit([&group, &body, &band = bands[i]] { group.Run(body, band); });
+    }
+    group.Run(body, bands[0]);
+    // Help with the queued bands instead of blocking, so nested calls from inside a
+    // task can't starve the pool.
+    while (group.remaining > 0) {
+        if (!thread_pool.TryRunTask()) {
+            std::unique_lock<std::mutex> lock(group.mutex);
+            group.done.wait_for(lock, IDLE_WAIT, [&group] { return group.remaining == 0; });
+        }
+    }
+    std::lock_guard<std::mutex> lock(group.mutex);
+    if (group.error) {
+        std::rethrow_exception(group.error);
+    }
+}
+
+void ParallelForRows(size_t rows, size_t alignment, const std::function<void(size_t begin, size_t end)>& body) {
+    ForEachBand(SplitRows(rows, alignment), [&body](const RowBand& band) { body(band.begin, band.end); });
+}
+
+SerialScope::SerialScope() : previous_(serial) {
+    serial = true;
+}
+
+SerialScope::~SerialScope() {
+    serial = previous_;
+}
+}  // namespace threads
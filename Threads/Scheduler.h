@@ -0,0 +1,49 @@
+#ifndef CPP_HSE_SCHEDULER_H
+#define CPP_HSE_SCHEDULER_H
+
+#include <functional>
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace threads {
+struct RowBand {
+    size_t index = 0;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// Number of threads, the calling one included, that filters run on. Defaults to the
+// number of hardware threads; meant to be set once at startup.
+void SetThreadCount(size_t thread_count);
+size_t GetThreadCount();
+ThreadPool& GetPool();
+
+// Splits rows [0, rows) into bands for the current thread count. Every band but the last
+// one has a multiple of alignment rows and at least halo rows, so the halo of a band only
+// reaches into its direct neighbours. The split only depends on the arguments and the
+// thread count, so it can be repeated for several passes over the same image.
+std::vector<RowBand> SplitRows(size_t rows, size_t alignment = 1, size_t halo = 0);
+
+// Runs body for every band on the thread pool, the calling thread included, and returns
+// when all of them are done. The first exception thrown by body is rethrown.
+void ForEachBand(const std::vector<RowBand>& bands, const std::function<void(const RowBand&)>& body);
+
+void ParallelForRows(size_t rows, size_t alignment, const std::function<void(size_t begin, size_t end)>& body);
+
+// While an object of this class exists, the current thread splits and runs row bands as if
+// there were a single thread. For work that is already spread over the pool at a coarser
+// level, such as one image per task.
+class SerialScope {
+public:
+    SerialScope();
+    SerialScope(const SerialScope&) = delete;
+    SerialScope& operator=(const SerialScope&) = delete;
+    ~SerialScope();
+
+private:
+    bool previous_;
+};
+}  // namespace threads
+
+#endif  // CPP_HSE_SCHEDULER_H
@@ -0,0 +1,105 @@
+#include "ThreadPool.h"
+
+namespace threads {
+namespace {
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_index = 0;
+}  // namespace
+
+ThreadPool::ThreadPool(size_t worker_count) {
+    for (size_t i = 0; i < worker_count; ++i) {
+        queues_.push_back(std::make_unique<TaskQueue>());
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::GetWorkerCount() const {
+    return workers_.size();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    if (workers_.empty()) {
+        task();
+        return;
+    }
+    size_t index = current_pool == this ? current_index : next_queue_++ % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        ++pending_;
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::TryRunTask() {
+    if (workers_.empty()) {
+        return false;
+    }
+    std::function<void()> task;
+    size_t index = current_pool == this ? current_index : next_queue_.load() % queues_.size();
+    if (TryPop(index, task) || TrySteal(index, task)) {
+        task();
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::TryPop(size_t queue_index, std::function<void()>& task) {
+    TaskQueue& queue = *queues_[queue_index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    --pending_;
+    return true;
+}
+
+bool ThreadPool::TrySteal(size_t thief_index, std::function<void()>& task) {
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        TaskQueue& queue = *queues_[(thief_index + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            --pending_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    current_pool = this;
+    current_index = index;
+    while (true) {
+        std::function<void()> task;
+        if (TryPop(index, task) || TrySteal(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this] { return stopping_ || pending_ > 0; });
+        if (stopping_ && pending_ == 0) {
+            return;
+        }
+    }
+}
+}  // namespace threads
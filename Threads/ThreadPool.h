@@ -0,0 +1,50 @@
+#ifndef CPP_HSE_THREAD_POOL_H
+#define CPP_HSE_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace threads {
+// Work-stealing thread pool. Every worker owns a task deque: it takes its own tasks from
+// the back and, when it runs out, steals from the front of the other workers' deques.
+// Tasks submitted from a worker go to that worker's deque, tasks from other threads are
+// spread over the deques round-robin.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t worker_count);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    size_t GetWorkerCount() const;
+    void Submit(std::function<void()> task);
+    // Runs one queued task on the calling thread, if there is any.
+    bool TryRunTask();
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool TryPop(size_t queue_index, std::function<void()>& task);
+    bool TrySteal(size_t thief_index, std::function<void()>& task);
+    void WorkerLoop(size_t index);
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_ = 0;
+    std::atomic<size_t> pending_ = 0;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
+}  // namespace threads
+
+#endif  // CPP_HSE_THREAD_POOL_H
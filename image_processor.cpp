@@ -8,22 +8,150 @@ std::vector<parser::Token> GetTokens(int argc, char* argv[]) {
     return tokens;
 }
 
-Image GetImage(const std::string& path) {
+Image GetImage(const std::string& path, const pipeline::FilterChain& chain, pipeline::Observer* observer) {
+    if (observer != nullptr) {
+        observer->OnStageBegin("read");
+    }
     reading_and_writing::Reader reader(path);
+    reader.Open();
+    pipeline::PushDownCrop(chain, reader);
     Image image = reader.Read();
+    if (observer != nullptr) {
+        observer->OnStageEnd("read", image.GetWidth() * image.GetHeight());
+    }
     return image;
 }
 
-void WriteImage(const std::string& path, const Image& image) {
-    reading_and_writing::Writer writer(path);
+void WriteImage(const std::string& path, const Image& image, const pipeline::FilterChain& chain,
+                pipeline::Observer* observer) {
+    if (observer != nullptr) {
+        observer->OnStageBegin("write");
+    }
+    reading_and_writing::Writer writer(path, pipeline::GetOutputFormat(chain));
     writer.Write(image);
+    if (observer != nullptr) {
+        observer->OnStageEnd("write", image.GetWidth() * image.GetHeight());
+    }
 }
 
-Image ApplyFilter(Image& image, const std::vector<parser::Token>& tokens) {
-    for (size_t i = 2; i < tokens.size(); ++i) {
-        image = filters::GetFilter(tokens[i])->Apply(image);
+void WritePyramid(const std::string& path, Image& image, const pipeline::FilterChain& chain, size_t levels,
+                  pipeline::Observer* observer) {
+    Image buffer;
+    for (size_t level = 1; level <= levels; ++level) {
+        // Bilinear weights over twice their width average every 2x2 block with a ring of
+        // its neighbours, 1 3 3 1 along each side, which doesn't alias.
+        const filters::Resize half((image.GetWidth() + 1) / 2, (image.GetHeight() + 1) / 2,
+                                   filters::ResamplingKernel::BILINEAR);
+        if (observer != nullptr) {
+            observer->OnStageBegin("pyramid");
+        }
+        half.ApplyTo(image, buffer);
+        std::swap(image, buffer);
+        if (observer != nullptr) {
+            observer->OnStageEnd("pyramid", image.GetWidth() * image.GetHeight());
+        }
+        WriteImage(pipeline::GetPyramidPath(path, level), image, chain, observer);
+    }
+}
+
+void ProcessImage(const std::vector<parser::Token>& tokens, const pipeline::Options& options,
+                  pipeline::Observer* observer) {
+    const pipeline::FilterChain chain = pipeline::Compile({tokens.begin() + 2, tokens.end()});
+    Image image = GetImage(tokens[0].name, chain, observer);
+    ApplyFilter(image, chain, observer);
+    WriteImage(tokens[1].name, image, chain, observer);
+    WritePyramid(tokens[1].name, image, chain, options.pyramid_levels, observer);
+}
+
+void ProcessCached(const std::vector<parser::Token>& tokens, const pipeline::Options& options,
+                   pipeline::Observer* observer) {
+    const std::string& input = tokens[0].name;
+    const std::string& output = tokens[1].name;
+    std::unique_ptr<pipeline::ResultCache> cache_holder;
+    std::string input_hash;
+    try {
+        cache_holder = std::make_unique<pipeline::ResultCache>(options.cache_directory, options.cache_limit, std::cerr);
+        input_hash = pipeline::ResultCache::HashFile(input);
+    } catch (const std::exception& e) {
+        // Like any other cache failure this only costs the reuse.
+        std::cerr << "cache: " << e.what() << std::endl;
+        ProcessImage(tokens, options, observer);
+        return;
+    }
+    pipeline::ResultCache& cache = *cache_holder;
+    const pipeline::FilterChain chain = pipeline::Compile({tokens.begin() + 2, tokens.end()});
+    const std::string output_key = pipeline::ResultCache::GetOutputKey(input_hash, chain, output);
+    std::string event = "output hit";
+    // Pyramids are built from the result of the last stage, so they need it as an image.
+    if (options.pyramid_levels > 0 || !cache.FetchOutput(output_key, output)) {
+        // The result of the whole chain is kept as well, since longer chains start with it.
+        size_t done = chain.size();
+        Image image;
+        while (done > 0 && !cache.LoadImage(pipeline::ResultCache::GetKey(input_hash, chain, done), image)) {
+            --done;
+        }
+        if (done > 0) {
+            event = "resumed after stage " + std::to_string(done) + " of " + std::to_string(chain.size());
+        } else {
+            event = "miss";
+            cache.CountMiss();
+            image = GetImage(input, chain, observer);
+        }
+        Image buffer;
+        for (size_t stage = done; stage < chain.size(); ++stage) {
+            pipeline::RunStages(chain, stage, stage + 1, image, buffer, observer);
+            cache.StoreImage(pipeline::ResultCache::GetKey(input_hash, chain, stage + 1), image);
+        }
+        WriteImage(output, image, chain, observer);
+        cache.StoreOutput(output_key, output);
+        WritePyramid(output, image, chain, options.pyramid_levels, observer);
+    }
+    cache.Flush();
+    if (options.verbose) {
+        std::cerr << "cache: " << event << "\n";
+        cache.PrintStatistics(std::cerr);
+    }
+}
+
+void ApplyFilter(Image& image, const pipeline::FilterChain& chain, pipeline::Observer* observer) {
+    pipeline::Run(chain, image, observer);
+}
+
+void StreamFilter(const std::vector<parser::Token>& tokens, pipeline::Observer* observer) {
+    pipeline::FilterChain chain = pipeline::Compile({tokens.begin() + 2, tokens.end()});
+    // Stages overlap band by band when streaming, so the whole run is a single stage.
+    if (observer != nullptr) {
+        observer->OnStageBegin("stream");
+    }
+    reading_and_writing::Reader reader(tokens[0].name);
+    reader.Open();
+    pipeline::PushDownCrop(chain, reader);
+    reading_and_writing::Writer writer(tokens[1].name, pipeline::GetOutputFormat(chain));
+    pipeline::RunStreaming(chain, reader, writer);
+    if (observer != nullptr) {
+        observer->OnStageEnd("stream", reader.GetWidth() * reader.GetHeight());
+    }
+}
+
+void ProcessBatch(const std::vector<parser::Token>& tokens, const pipeline::Options& options) {
+    pipeline::FilterChain chain = pipeline::Compile({tokens.begin() + 2, tokens.end()});
+    std::vector<pipeline::BatchJob> jobs = pipeline::ListBatchJobs(tokens[0].name, tokens[1].name);
+    pipeline::BatchSummary summary = pipeline::RunBatch(chain, jobs, options.stream, std::cerr);
+    const double seconds = std::max(summary.seconds, 1e-9);
+    std::cout << "Processed " << summary.files - summary.failed << " of " << summary.files << " files in "
+              << summary.seconds << " s: " << static_cast<double>(summary.files) / seconds << " files/s, "
+              << static_cast<double>(summary.bytes) / seconds / 1e6 << " MB/s\n";
+}
+
+void Serve(const std::vector<parser::Token>& tokens) {
+    if (tokens.size() > 2) {
+        throw std::invalid_argument("Option --serve takes no filters, jobs bring their own");
+    }
+    if (tokens[1].name == "-") {
+        server::ServeStandardStreams();
+    } else {
+        server::ServeSocket(tokens[1].name);
     }
-    return image;
 }
 
 int main(int argc, char** argv) {
@@ -39,22 +167,85 @@ int main(int argc, char** argv) {
             << "{program name} {input file path} {output file path} [-{filter name 1} [filter parameter 1] "
                "[filter parameter 2] ...] [-{filter name 2} [filter parameter 1] [filter parameter 2] ...] ...\n\n";
 
+        std::cout << "formats:\n";
+        std::cout << "  BMP, QOI, PPM and PGM files are read whatever their name is. Output files are written\n"
+                     "  as QOI, PPM, PGM (luma only) or, for .pnm, as PGM when the result is gray and PPM\n"
+                     "  otherwise, by their extension; as BMP for any other name.\n\n";
+
         std::cout << "filters:\n";
         std::cout << "  -crop [width] [height]\n";
         std::cout << "  -neg\n";
         std::cout << "  -gs\n";
         std::cout << "  -sharp\n";
         std::cout << "  -edge [threshold]\n";
-        std::cout << "  -blur [sigma]\n";
-        std::cout << "  -pix [pixel size]\n";
+        std::cout << "  -blur [sigma] [exact|iir]\n";
+        std::cout << "  -pix [pixel size] [avg]\n";
+        std::cout << "  -boxblur [radius]\n";
+        std::cout << "  -resize [width] [height] [bilinear|bicubic|lanczos3]  (default: bicubic)\n";
+        std::cout << "  -conv [kernel] [divisor]  kernel inline as \"1,2,1;2,4,2;1,2,1\" or a text file\n"
+                     "                with a row per line; odd dimensions, edges repeated\n\n";
+
+        std::cout << "server:\n";
+        std::cout << "  {program name} --serve {socket path | -} [-j threads]\n";
+        std::cout << "  takes newline-delimited JSON jobs on a UNIX socket or, for -, on standard input:\n";
+        std::cout << "  {\"id\": 1, \"input\": \"in.bmp\", \"output\": \"out.bmp\", \"filters\": \"-crop 100 100 -gs\"}\n\n";
+
+        std::cout << "options:\n";
+        std::cout << "  -j [threads]  number of threads to run filters on (default: all hardware threads)\n";
+        std::cout << "  --stream      process the image in row bands instead of loading it whole\n";
+        std::cout << "  --batch       treat the input as a directory or a manifest of images and the output\n"
+                     "                as a directory, and process all of them with the same filters; a manifest\n"
+                     "                lists an input and an optional output path per line, in \"quotes\" if\n"
+                     "                they have spaces\n";
+        std::cout << "  --profile [table|json]  print the time and memory every stage took to stderr\n";
+        std::cout << "  --explain     print how the filters will be run instead of running them\n";
+        std::cout << "  --verbose     print how the filters will be run to stderr, then run them\n";
+        std::cout << "  -pyramid [levels]  also write levels of half the size of the one before,\n"
+                     "                out.bmp gets out_1.bmp, out_2.bmp and so on\n";
+        std::cout << "  --pool [limit MB] [prefault] [hugepages]\n"
+                     "                how much released image memory to keep for reuse (default: 1024 MB),\n"
+                     "                and whether to fault in and back large images with huge pages\n";
+        std::cout << "  --cache [directory] [limit MB]\n"
+                     "                keep results in the directory and reuse them for the same input file\n"
+                     "                and filters, or filters that start the same (default limit: 1024 MB)\n";
 
         return 0;
     }
     try {
         std::vector<parser::Token> tokens = GetTokens(argc, argv);
-        Image image = GetImage(tokens[0].name);
-        image = ApplyFilter(image, tokens);
-        WriteImage(tokens[1].name, image);
+        pipeline::Options options = pipeline::ExtractOptions(tokens);
+        if (options.thread_count != 0) {
+            threads::SetThreadCount(options.thread_count);
+        }
+        GetBufferPool().SetRetainedLimit(options.pool_limit);
+        GetBufferPool().SetPrefault(options.prefault);
+        GetBufferPool().SetHugePages(options.huge_pages);
+        std::unique_ptr<pipeline::Profiler> profiler;
+        if (!options.profile.empty()) {
+            profiler = std::make_unique<pipeline::Profiler>();
+        }
+        if (options.verbose && !options.explain && tokens[0].name != "--serve") {
+            std::cerr << "stages:\n";
+            pipeline::PrintStages(pipeline::Compile({tokens.begin() + 2, tokens.end()}), std::cerr);
+        }
+        if (options.explain) {
+            pipeline::Explain({tokens.begin() + 2, tokens.end()}, std::cout);
+        } else if (tokens[0].name == "--serve") {
+            Serve(tokens);
+        } else if (options.batch) {
+            ProcessBatch(tokens, options);
+        } else if (options.stream) {
+            StreamFilter(tokens, profiler.get());
+        } else if (!options.cache_directory.empty() && std::filesystem::is_regular_file(tokens[0].name)) {
+            ProcessCached(tokens, options, profiler.get());
+        } else {
+            ProcessImage(tokens, options, profiler.get());
+        }
+        if (profiler && options.profile == "json") {
+            profiler->PrintJson(std::cerr);
+        } else if (profiler) {
+            profiler->PrintTable(std::cerr);
+        }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
     }
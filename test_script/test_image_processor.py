@@ -13,14 +13,23 @@ import tempfile
 
 def calc_images_distance(image_path1, image_path2):
     with Image.open(image_path1) as image1, Image.open(image_path2) as image2:
-        histogram = ImageChops.difference(image1, image2).histogram()
+        # Gray results are stored as 8-bit palettized BMPs, compare them as RGB.
+        histogram = ImageChops.difference(image1.convert("RGB"), image2.convert("RGB")).histogram()
 
         return math.sqrt(reduce(operator.add, map(lambda h, i: h * (i ** 2), histogram, range(256))) / (
                 float(image1.size[0]) * image1.size[1]))
 
 
 class ImageProcessorTester:
-    TestCase = namedtuple("TestCase", ["name", "input", "args", "eps"])
+    # The expected output is "{input}_{expected}.bmp", "{input}_{name}.bmp" if expected is None.
+    TestCase = namedtuple("TestCase", ["name", "input", "args", "eps", "expected"], defaults=[None])
+    RoundTripCase = namedtuple("RoundTripCase", ["input", "extension"])
+    StreamCase = namedtuple("StreamCase", ["name", "args", "eps"])
+    RejectCase = namedtuple("RejectCase", ["name", "args"])
+    DecodeCase = namedtuple("DecodeCase", ["input", "expected"])
+    CacheCase = namedtuple("CacheCase", ["name", "runs", "limit", "events"])
+    PlanCase = namedtuple("PlanCase", ["name", "filters", "eps"])
+    PyramidCase = namedtuple("PyramidCase", ["name", "args", "levels", "gray"])
 
     class TestCaseFailedException(Exception):
         pass
@@ -68,11 +77,113 @@ class ImageProcessorTester:
                 ImageProcessorTester.TestCase(input="flag", name="sharp", args=["-sharp"], eps=1.0)
             ],
             "blur": [
+                # The noise references are exact Gaussians rounded once per -blur. The fixed-point blur
+                # truncates its result, up to a level below them, and two blurs run merged into one of
+                # sigma sqrt(s1^2 + s2^2), which skips the rounding between them and differs where the
+                # edges repeat. Together that keeps them within 0.8 of the references; the original float
+                # blur, which truncates after every pass, is 2.0 off.
+                ImageProcessorTester.TestCase(input="noise", name="blur", args=["-blur", "7.5"], eps=2.0),
+                ImageProcessorTester.TestCase(input="noise", name="blur_blur", args=["-blur", "7.5", "-blur", "3"],
+                                              eps=2.0),
                 ImageProcessorTester.TestCase(input="lenna", name="blur", args=["-blur", "7.5"], eps=2.0),
                 ImageProcessorTester.TestCase(input="lenna", name="blur_blur", args=["-blur", "7.5", "-blur", "3"],
                                               eps=2.0),
             ],
+            # Means of integers, which are exact whatever the rows the threads split the image into.
+            "boxblur": [
+                ImageProcessorTester.TestCase(input="noise", name="boxblur", args=["-boxblur", "3"], eps=0.0),
+                ImageProcessorTester.TestCase(input="noise", name="boxblur_j3", args=["-boxblur", "3", "-j", "3"],
+                                              eps=0.0, expected="boxblur"),
+                ImageProcessorTester.TestCase(input="noise", name="boxblur_wide", args=["-boxblur", "40"], eps=0.0),
+                ImageProcessorTester.TestCase(input="noise", name="boxblur_wide_j3",
+                                              args=["-boxblur", "40", "-j", "3"], eps=0.0, expected="boxblur_wide"),
+            ],
+            "pix": [
+                ImageProcessorTester.TestCase(input="noise", name="pix_avg", args=["-pix", "7", "avg"], eps=0.0),
+                ImageProcessorTester.TestCase(input="noise", name="pix_avg_j3", args=["-pix", "7", "avg", "-j", "3"],
+                                              eps=0.0, expected="pix_avg"),
+            ],
+            "resize": [
+                ImageProcessorTester.TestCase(input="noise", name="resize_bilinear",
+                                              args=["-resize", "97", "71", "bilinear"], eps=1.0),
+                ImageProcessorTester.TestCase(input="noise", name="resize_bicubic", args=["-resize", "23", "17"],
+                                              eps=1.0),
+                ImageProcessorTester.TestCase(input="noise", name="resize_lanczos3",
+                                              args=["-resize", "40", "90", "lanczos3"], eps=1.0),
+            ],
+            "conv": [
+                ImageProcessorTester.TestCase(input="noise", name="conv_separable",
+                                              args=["-conv", "1,2,1;2,4,2;1,2,1", "16"], eps=1.0),
+                ImageProcessorTester.TestCase(input="noise", name="conv_2d",
+                                              args=["-conv", "1,2,0,-1,1;0,3,1,2,0;-1,1,4,0,2", "15"], eps=1.0),
+                ImageProcessorTester.TestCase(input="noise", name="conv_row", args=["-conv", "1,2,3,2,1", "9"],
+                                              eps=1.0),
+                ImageProcessorTester.TestCase(input="noise", name="conv_2d_file",
+                                              args=["-conv", os.path.join("test_script", "data", "noise_conv_2d.txt"),
+                                                    "15"],
+                                              eps=1.0, expected="conv_2d"),
+            ],
         }
+        reject_test_cases = [
+            ImageProcessorTester.RejectCase(name="conv_even", args=["-conv", "1,2;3,4"]),
+            ImageProcessorTester.RejectCase(name="conv_ragged", args=["-conv", "1,2,1;1,2"]),
+        ]
+        # Other encodings of the same pixels as a 24-bit bottom-up BMP.
+        decode_test_cases = [
+            ImageProcessorTester.DecodeCase(input="flag_32bit", expected="flag"),
+            ImageProcessorTester.DecodeCase(input="flag_bitfields", expected="flag"),
+            ImageProcessorTester.DecodeCase(input="flag_top_down", expected="flag"),
+            ImageProcessorTester.DecodeCase(input="flag_palette", expected="flag"),
+            ImageProcessorTester.DecodeCase(input="flag_gs_palette", expected="flag_gs"),
+        ]
+        # Levels of noise.bmp are compared with noise_pyramid_{level}.bmp unless they are gray.
+        pyramid_test_cases = [
+            ImageProcessorTester.PyramidCase(name="pyramid", args=["-pyramid", "3"], levels=3, gray=False),
+            ImageProcessorTester.PyramidCase(name="gs_pyramid", args=["-gs", "-pyramid", "2"], levels=2, gray=True),
+        ]
+        # Chains the planner rewrites, run on noise.bmp; every filter is also run on its own, which
+        # leaves the planner nothing to rewrite.
+        plan_test_cases = [
+            ImageProcessorTester.PlanCase(name="sharp_crop", filters=[["-sharp"], ["-crop", "30", "20"]], eps=0.0),
+            ImageProcessorTester.PlanCase(name="blur_crop", filters=[["-blur", "3"], ["-crop", "30", "20"]], eps=0.0),
+            ImageProcessorTester.PlanCase(name="pix_avg_crop", filters=[["-pix", "7", "avg"], ["-crop", "30", "20"]],
+                                          eps=0.0),
+            ImageProcessorTester.PlanCase(name="neg_neg", filters=[["-neg"], ["-neg"]], eps=0.0),
+            # Sizes too large for the planner's arithmetic saturate rather than fail.
+            ImageProcessorTester.PlanCase(name="sharp_huge_crop",
+                                          filters=[["-sharp"], ["-crop", "99999999999999999999999", "5"]], eps=0.0),
+            ImageProcessorTester.PlanCase(name="huge_crop_crop",
+                                          filters=[["-crop", "99999999999999999999999", "5"], ["-crop", "3", "3"]],
+                                          eps=0.0),
+        ]
+        # Runs of noise.bmp into one cache directory, with what the cache does on each of them.
+        cache_test_cases = [
+            ImageProcessorTester.CacheCase(name="repeat", runs=[["-blur", "3", "-sharp"], ["-blur", "3", "-sharp"]],
+                                           limit="1024", events=["miss", "output hit"]),
+            ImageProcessorTester.CacheCase(name="resume", runs=[["-blur", "3"], ["-blur", "3", "-sharp"]],
+                                           limit="1024", events=["miss", "resumed after stage 1 of 2"]),
+            ImageProcessorTester.CacheCase(name="evict", runs=[["-blur", "3", "-sharp"], ["-blur", "3", "-sharp"]],
+                                           limit="0", events=["miss", "miss"]),
+        ]
+        round_trip_test_cases = [
+            ImageProcessorTester.RoundTripCase(input="flag", extension="qoi"),
+            ImageProcessorTester.RoundTripCase(input="flag", extension="ppm"),
+            ImageProcessorTester.RoundTripCase(input="flag_edge", extension="qoi"),
+            ImageProcessorTester.RoundTripCase(input="flag_gs", extension="pgm"),
+            ImageProcessorTester.RoundTripCase(input="flag_gs", extension="pnm"),
+            ImageProcessorTester.RoundTripCase(input="lenna_crop_crop", extension="qoi"),
+            ImageProcessorTester.RoundTripCase(input="lenna_crop_crop", extension="ppm"),
+        ]
+        # Run on an image tall enough to be streamed in several bands. Recursive blurs see a
+        # halo of 4 sigma around every band, which is off from whole columns by float
+        # rounding: at most a level, which sharpening after them amplifies.
+        stream_test_cases = [
+            ImageProcessorTester.StreamCase(name="blur_exact", args=["-blur", "3"], eps=0.0),
+            ImageProcessorTester.StreamCase(name="blur_iir", args=["-blur", "25"], eps=0.5),
+            ImageProcessorTester.StreamCase(name="blur_iir_sharp", args=["-blur", "25", "-sharp"], eps=1.0),
+            ImageProcessorTester.StreamCase(name="edge_boxblur", args=["-edge", "0.1", "-boxblur", "4"], eps=0.0),
+            ImageProcessorTester.StreamCase(name="resize", args=["-resize", "20", "50000"], eps=0.0),
+        ]
         ok_filters = set()
 
         for filter_name, test_cases in filter_test_cases.items():
@@ -83,6 +194,55 @@ class ImageProcessorTester:
             except ImageProcessorTester.TestCaseFailedException:
                 pass
 
+        try:
+            for test_case in reject_test_cases:
+                self.run_reject_test_case(test_case)
+            ok_filters.add("errors")
+        except ImageProcessorTester.TestCaseFailedException:
+            pass
+
+        try:
+            for test_case in decode_test_cases:
+                self.run_decode_test_case(test_case)
+            ok_filters.add("bmp")
+        except ImageProcessorTester.TestCaseFailedException:
+            pass
+
+        try:
+            for test_case in pyramid_test_cases:
+                self.run_pyramid_test_case(test_case)
+            ok_filters.add("pyramid")
+        except ImageProcessorTester.TestCaseFailedException:
+            pass
+
+        try:
+            for test_case in plan_test_cases:
+                self.run_plan_test_case(test_case)
+            ok_filters.add("plan")
+        except ImageProcessorTester.TestCaseFailedException:
+            pass
+
+        try:
+            for test_case in cache_test_cases:
+                self.run_cache_test_case(test_case)
+            ok_filters.add("cache")
+        except ImageProcessorTester.TestCaseFailedException:
+            pass
+
+        try:
+            for test_case in round_trip_test_cases:
+                self.run_round_trip_test_case(test_case)
+            ok_filters.add("formats")
+        except ImageProcessorTester.TestCaseFailedException:
+            pass
+
+        try:
+            for test_case in stream_test_cases:
+                self.run_stream_test_case(test_case)
+            ok_filters.add("stream")
+        except ImageProcessorTester.TestCaseFailedException:
+            pass
+
         if ok_filters:
             print("-----\nTOTAL {ok_filters_count} OK FILTERS: {ok_filters}\n-----".format(
                 ok_filters_count=len(ok_filters),
@@ -95,7 +255,8 @@ class ImageProcessorTester:
     def run_test_case(self, test_case):
         try:
             input_file_name = "{input}.bmp".format(input=test_case.input)
-            output_file_name = "{input}_{name}.bmp".format(input=test_case.input, name=test_case.name)
+            output_file_name = "{input}_{name}.bmp".format(input=test_case.input,
+                                                           name=test_case.expected or test_case.name)
             input_file = os.path.join("test_script", "data", input_file_name)
             expected_output_file = os.path.join("test_script", "data", output_file_name)
 
@@ -119,6 +280,229 @@ class ImageProcessorTester:
         except UnidentifiedImageError:
             self.fail_test_case(test_case.input, test_case.name, "output file is corrupt")
 
+    def run_reject_test_case(self, test_case):
+        # Invalid arguments are reported before the input is read, and nothing is written.
+        name = "reject_{name}".format(name=test_case.name)
+        try:
+            input_file = os.path.join("test_script", "data", "flag.bmp")
+
+            with tempfile.TemporaryDirectory() as output_directory:
+                output_file = os.path.join(output_directory, "out.bmp")
+                result = subprocess.run([self.image_processor_executable, input_file, output_file] + test_case.args,
+                                        stderr=subprocess.PIPE, timeout=180)
+                if os.path.exists(output_file):
+                    self.fail_test_case("flag", name, "invalid arguments were accepted")
+                if not result.stderr:
+                    self.fail_test_case("flag", name, "no error was reported")
+
+            self.succeed_test_case("flag", name)
+        except subprocess.TimeoutExpired:
+            self.fail_test_case("flag", name, "timeout")
+
+    def run_decode_test_case(self, test_case):
+        # Rows are read in bands when streaming, so both ways have to find them.
+        for args in [[], ["--stream"]]:
+            name = "decode_stream" if args else "decode"
+            try:
+                input_file = os.path.join("test_script", "data", "{input}.bmp".format(input=test_case.input))
+                expected_file = os.path.join("test_script", "data", "{expected}.bmp".format(
+                    expected=test_case.expected))
+
+                with tempfile.NamedTemporaryFile(suffix=".bmp") as output_file:
+                    subprocess.check_call([self.image_processor_executable, input_file, output_file.name] + args,
+                                          timeout=180)
+
+                    images_distance = calc_images_distance(expected_file, output_file.name)
+                    if images_distance > 0:
+                        self.fail_test_case(test_case.input, name,
+                                            "decoded image differs from {expected} with rms diff {diff}".format(
+                                                expected=test_case.expected, diff=images_distance))
+
+                self.succeed_test_case(test_case.input, name)
+            except subprocess.CalledProcessError:
+                self.fail_test_case(test_case.input, name, "image_processor finished with non-zero exit code")
+            except subprocess.TimeoutExpired:
+                self.fail_test_case(test_case.input, name, "timeout")
+            except UnidentifiedImageError:
+                self.fail_test_case(test_case.input, name, "output file is corrupt")
+
+    def run_pyramid_test_case(self, test_case):
+        # Every level is named after the output and has half the size of the one before, rounded up.
+        name = test_case.name
+        try:
+            input_file = os.path.join("test_script", "data", "noise.bmp")
+
+            with tempfile.TemporaryDirectory() as output_directory:
+                subprocess.check_call([self.image_processor_executable, input_file,
+                                       os.path.join(output_directory, "out.bmp")] + test_case.args, timeout=180)
+
+                level_names = ["out.bmp"] + ["out_{level}.bmp".format(level=level)
+                                             for level in range(1, test_case.levels + 1)]
+                if sorted(os.listdir(output_directory)) != sorted(level_names):
+                    self.fail_test_case("noise", name, "expected {expected}, got {files}".format(
+                        expected=level_names, files=sorted(os.listdir(output_directory))))
+                with Image.open(input_file) as image:
+                    width, height = image.size
+                for level, level_name in enumerate(level_names):
+                    with Image.open(os.path.join(output_directory, level_name)) as image:
+                        if image.size != (width, height):
+                            self.fail_test_case("noise", name,
+                                                "{file} is {size[0]}x{size[1]}, not {width}x{height}".format(
+                                                    file=level_name, size=image.size, width=width, height=height))
+                        if test_case.gray:
+                            self.check_gray_level(name, level_name, image)
+                    if level > 0 and not test_case.gray:
+                        expected_file = os.path.join("test_script", "data", "noise_pyramid_{level}.bmp".format(
+                            level=level))
+                        images_distance = calc_images_distance(expected_file, os.path.join(output_directory,
+                                                                                           level_name))
+                        if images_distance > 1.0:
+                            self.fail_test_case("noise", name,
+                                                "{file} differs from expected with rms diff {diff}".format(
+                                                    file=level_name, diff=images_distance))
+                    width, height = (width + 1) // 2, (height + 1) // 2
+
+            self.succeed_test_case("noise", name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case("noise", name, "image_processor finished with non-zero exit code")
+        except subprocess.TimeoutExpired:
+            self.fail_test_case("noise", name, "timeout")
+        except FileNotFoundError:
+            self.fail_test_case("noise", name, "output file not found")
+        except UnidentifiedImageError:
+            self.fail_test_case("noise", name, "output file is corrupt")
+
+    def check_gray_level(self, name, level_name, image):
+        # Gray results are written as 8-bit BMPs unless the palette outweighs what that saves.
+        width, height = image.size
+        if 256 * 4 + height * ((width + 3) // 4 * 4) < height * ((width * 3 + 3) // 4 * 4) and \
+                image.mode not in ("L", "P"):
+            self.fail_test_case("noise", name, "{file} is not an 8-bit image".format(file=level_name))
+        red, green, blue = image.convert("RGB").split()
+        if ImageChops.difference(red, green).getbbox() or ImageChops.difference(red, blue).getbbox():
+            self.fail_test_case("noise", name, "{file} is not gray".format(file=level_name))
+
+    def run_plan_test_case(self, test_case):
+        # The planned chain has to give the pixels of the filters run one by one.
+        name = "plan_{name}".format(name=test_case.name)
+        try:
+            input_file = os.path.join("test_script", "data", "noise.bmp")
+
+            with tempfile.TemporaryDirectory() as steps_directory, \
+                    tempfile.NamedTemporaryFile(suffix=".bmp") as output_file:
+                expected_file = input_file
+                for i, args in enumerate(test_case.filters):
+                    step_file = os.path.join(steps_directory, "{step}.bmp".format(step=i))
+                    subprocess.check_call([self.image_processor_executable, expected_file, step_file] + args,
+                                          timeout=180)
+                    expected_file = step_file
+                subprocess.check_call([self.image_processor_executable, input_file, output_file.name] +
+                                      [arg for args in test_case.filters for arg in args], timeout=180)
+
+                images_distance = calc_images_distance(expected_file, output_file.name)
+                if images_distance > test_case.eps:
+                    self.fail_test_case("noise", name,
+                                        "planned output differs with rms diff {diff}".format(diff=images_distance))
+
+            self.succeed_test_case("noise", name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case("noise", name, "image_processor finished with non-zero exit code")
+        except subprocess.TimeoutExpired:
+            self.fail_test_case("noise", name, "timeout")
+        except FileNotFoundError:
+            self.fail_test_case("noise", name, "output file not found")
+        except UnidentifiedImageError:
+            self.fail_test_case("noise", name, "output file is corrupt")
+
+    def run_cache_test_case(self, test_case):
+        # Whatever the cache does, every run has to give the pixels of a run without it.
+        name = "cache_{name}".format(name=test_case.name)
+        try:
+            input_file = os.path.join("test_script", "data", "noise.bmp")
+
+            with tempfile.TemporaryDirectory() as cache_directory:
+                for args, event in zip(test_case.runs, test_case.events):
+                    with tempfile.NamedTemporaryFile(suffix=".bmp") as expected_file, \
+                            tempfile.NamedTemporaryFile(suffix=".bmp") as output_file:
+                        subprocess.check_call([self.image_processor_executable, input_file, expected_file.name] + args,
+                                              timeout=180)
+                        log = subprocess.run([self.image_processor_executable, input_file, output_file.name] + args +
+                                             ["--cache", cache_directory, test_case.limit, "--verbose"],
+                                             stderr=subprocess.PIPE, universal_newlines=True, check=True,
+                                             timeout=180).stderr
+
+                        if "cache: {event}\n".format(event=event) not in log:
+                            self.fail_test_case("noise", name, "expected \"cache: {event}\", got:\n{log}".format(
+                                event=event, log=log))
+                        images_distance = calc_images_distance(expected_file.name, output_file.name)
+                        if images_distance > 0:
+                            self.fail_test_case("noise", name,
+                                                "cached output differs with rms diff {diff}".format(
+                                                    diff=images_distance))
+
+            self.succeed_test_case("noise", name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case("noise", name, "image_processor finished with non-zero exit code")
+        except subprocess.TimeoutExpired:
+            self.fail_test_case("noise", name, "timeout")
+        except UnidentifiedImageError:
+            self.fail_test_case("noise", name, "output file is corrupt")
+
+    def run_round_trip_test_case(self, test_case):
+        # The image is converted to the format and back to BMP, which has to give the same pixels.
+        name = "to_{extension}".format(extension=test_case.extension)
+        try:
+            input_file = os.path.join("test_script", "data", "{input}.bmp".format(input=test_case.input))
+
+            with tempfile.NamedTemporaryFile(suffix="." + test_case.extension) as converted_file, \
+                    tempfile.NamedTemporaryFile(suffix=".bmp") as output_file:
+                subprocess.check_call([self.image_processor_executable, input_file, converted_file.name], timeout=180)
+                subprocess.check_call([self.image_processor_executable, converted_file.name, output_file.name],
+                                      timeout=180)
+
+                images_distance = calc_images_distance(input_file, output_file.name)
+                if images_distance > 0:
+                    self.fail_test_case(test_case.input, name,
+                                        "round trip changed the image with rms diff {diff}".format(
+                                            diff=images_distance))
+
+            self.succeed_test_case(test_case.input, name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(test_case.input, name, "image_processor finished with non-zero exit code")
+        except subprocess.TimeoutExpired:
+            self.fail_test_case(test_case.input, name, "timeout")
+        except UnidentifiedImageError:
+            self.fail_test_case(test_case.input, name, "output file is corrupt")
+
+    def run_stream_test_case(self, test_case):
+        # Streaming has to give the same pixels as processing the whole image at once.
+        name = "stream_{name}".format(name=test_case.name)
+        try:
+            input_file = os.path.join("test_script", "data", "flag.bmp")
+
+            with tempfile.NamedTemporaryFile(suffix=".bmp") as tall_file, \
+                    tempfile.NamedTemporaryFile(suffix=".bmp") as expected_file, \
+                    tempfile.NamedTemporaryFile(suffix=".bmp") as output_file:
+                subprocess.check_call([self.image_processor_executable, input_file, tall_file.name, "-resize", "37",
+                                       "120000"], timeout=180)
+                subprocess.check_call([self.image_processor_executable, tall_file.name, expected_file.name] +
+                                      test_case.args, timeout=180)
+                subprocess.check_call([self.image_processor_executable, tall_file.name, output_file.name,
+                                       "--stream"] + test_case.args, timeout=180)
+
+                images_distance = calc_images_distance(expected_file.name, output_file.name)
+                if images_distance > test_case.eps:
+                    self.fail_test_case("flag", name,
+                                        "streamed output differs with rms diff {diff}".format(diff=images_distance))
+
+            self.succeed_test_case("flag", name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case("flag", name, "image_processor finished with non-zero exit code")
+        except subprocess.TimeoutExpired:
+            self.fail_test_case("flag", name, "timeout")
+        except UnidentifiedImageError:
+            self.fail_test_case("flag", name, "output file is corrupt")
+
 
 if __name__ == "__main__":
     tester = ImageProcessorTester(image_processor_executable=sys.argv[1])